@@ -1,23 +1,26 @@
-// directory.cc 
+// directory.cc
 //	Routines to manage a directory of file names.
 //
-//	The directory is a table of fixed length entries; each
+//	The directory is a hash table of variable length entries; each
 //	entry represents a single file, and contains the file name,
-//	and the location of the file header on disk.  The fixed size
-//	of each directory entry means that we have the restriction
-//	of a fixed maximum size for file names.
+//	and the location of the file header on disk.  Names are stored
+//	inline, so they may be as long as FileNameMaxLen.
 //
-//	The constructor initializes an empty directory of a certain size;
-//	we use ReadFrom/WriteBack to fetch the contents of the directory
-//	from disk, and to write back any modifications back to disk.
+//	The directory file is made of sector-sized pages.  Page 0 holds
+//	the header, with the first page of each hash bucket; the entries
+//	of a bucket live in a chain of pages.  The table grows one bucket
+//	at a time (linear hashing), so a lookup reads a page or two no
+//	matter how many files the directory holds, and the directory can
+//	grow as long as there is space on the disk.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
-//	Fixing this is one of the parts to the assignment.
+//	The constructor initializes an empty directory;
+//	we use FetchFrom/WriteBack to fetch the contents of the directory
+//	from disk, and to write back any modifications back to disk.
+//	Pages are read in as they are needed, and only the pages that
+//	changed are written back.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
-// All rights reserved.  See copyright.h for copyright notice and limitation 
+// All rights reserved.  See copyright.h for copyright notice and limitation
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
@@ -25,21 +28,58 @@
 #include "filehdr.h"
 #include "directory.h"
 
+// Bytes in front of the name of a packed entry: sector, type, length
+#define EntryHeaderSize		(sizeof(int) + 2)
+
+//----------------------------------------------------------------------
+// HashName
+// 	Hash a file name (FNV-1a), to pick its bucket.
+//----------------------------------------------------------------------
+
+static unsigned int
+HashName(char *name)
+{
+    unsigned int hash = 2166136261u;
+
+    for (; *name != '\0'; name++)
+	hash = (hash ^ (unsigned char)*name) * 16777619u;
+    return hash;
+}
+
+//----------------------------------------------------------------------
+// UnpackEntry
+// 	Unpack the entry at "offset" in "entries", and return the number
+//	of bytes it takes up.
+//----------------------------------------------------------------------
+
+static int
+UnpackEntry(char *entries, int offset, DirectoryEntry *entry)
+{
+    char *packed = &entries[offset];
+    int length = (unsigned char)packed[sizeof(int) + 1];
+
+    memcpy(&entry->sector, packed, sizeof(int));
+    entry->type = (FileType)packed[sizeof(int)];
+    memcpy(entry->name, &packed[EntryHeaderSize], length);
+    entry->name[length] = '\0';
+    return EntryHeaderSize + length;
+}
+
 //----------------------------------------------------------------------
 // Directory::Directory
 // 	Initialize a directory; initially, the directory is completely
 //	empty.  If the disk is being formatted, an empty directory
 //	is all we need, but otherwise, we need to call FetchFrom in order
 //	to initialize it from disk.
-//
-//	"size" is the number of entries in the directory
 //----------------------------------------------------------------------
-Directory::Directory(int size)
+Directory::Directory()
 {
-    table = new DirectoryEntry[size];
-    tableSize = size;
-    for (int i = 0; i < tableSize; i++)
-	    table[i].inUse = FALSE;
+    dirFile = NULL;
+    pages = NULL;
+    dirty = NULL;
+    pageCapacity = 0;
+    diskPages = 0;
+    MakeEmpty();
 }
 
 //----------------------------------------------------------------------
@@ -47,91 +87,323 @@ Directory::Directory(int size)
 // 	De-allocate directory data structure.
 //----------------------------------------------------------------------
 Directory::~Directory()
-{ 
-    delete [] table;
-} 
+{
+    Clear();
+    delete [] pages;
+    delete [] dirty;
+    delete dirFile;
+}
 
 //----------------------------------------------------------------------
 // Directory::FetchFrom
-// 	Read the contents of the directory from disk.
+// 	Attach the directory to its file on disk.  Only the header page
+//	is read now; the others are read in as they are needed.  A file
+//	that has never been written as a directory reads as empty.
 //
 //	"file" -- file containing the directory contents
 //----------------------------------------------------------------------
 void
 Directory::FetchFrom(OpenFile *file)
 {
-    (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    Clear();
+    delete dirFile;
+    dirFile = new OpenFile(file->GetHdrSector());
+    diskPages = dirFile->Length() / DirPageSize;
+
+    if (diskPages == 0)
+	MakeEmpty();
+    else {
+	header = (DirectoryHeader *)GetPage(0);
+	if (header->numBuckets == 0)
+	    MakeEmpty();
+    }
 }
 
 //----------------------------------------------------------------------
 // Directory::WriteBack
-// 	Write any modifications to the directory back to disk
+// 	Write the pages that changed back to disk.  New pages are always
+//	dirty, so writing in page order extends the file without holes.
 //
 //	"file" -- file to contain the new directory contents
 //----------------------------------------------------------------------
 void
 Directory::WriteBack(OpenFile *file)
 {
-    (void) file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    for (int i = 0; i < header->numPages; i++)
+	if (pages[i] != NULL && dirty[i]) {
+	    (void) file->WriteAt(pages[i], DirPageSize, i * DirPageSize);
+	    dirty[i] = FALSE;
+	}
+    if (diskPages < header->numPages)
+	diskPages = header->numPages;
+}
+
+//----------------------------------------------------------------------
+// Directory::Clear
+// 	Drop all the pages read in so far, without writing them back.
+//----------------------------------------------------------------------
+void
+Directory::Clear()
+{
+    for (int i = 0; i < pageCapacity; i++) {
+	delete [] pages[i];
+	pages[i] = NULL;
+	dirty[i] = FALSE;
+    }
+    header = NULL;
+}
+
+//----------------------------------------------------------------------
+// Directory::MakeEmpty
+// 	Set up the header and the single bucket of a directory with no
+//	files in it.  Everything is dirty, so WriteBack stores it all.
+//----------------------------------------------------------------------
+void
+Directory::MakeEmpty()
+{
+    header = (DirectoryHeader *)GetPage(0);
+    header->numEntries = 0;
+    header->numPages = 1;
+    header->numBuckets = 0;
+    header->bucket[header->numBuckets++] = NewPage();
+    dirty[0] = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::GetPage
+// 	Return page "page" of the directory, reading it from disk the
+//	first time it is asked for.
+//----------------------------------------------------------------------
+DirectoryPage *
+Directory::GetPage(int page)
+{
+    if (page >= pageCapacity) {
+	int newCapacity = (pageCapacity == 0) ? 4 : 2 * pageCapacity;
+	while (newCapacity <= page)
+	    newCapacity *= 2;
+	char **newPages = new char *[newCapacity];
+	bool *newDirty = new bool[newCapacity];
+	for (int i = 0; i < newCapacity; i++) {
+	    newPages[i] = (i < pageCapacity) ? pages[i] : NULL;
+	    newDirty[i] = (i < pageCapacity) ? dirty[i] : FALSE;
+	}
+	delete [] pages;
+	delete [] dirty;
+	pages = newPages;
+	dirty = newDirty;
+	pageCapacity = newCapacity;
+    }
+    if (pages[page] == NULL) {
+	pages[page] = new char[DirPageSize];
+	if (page < diskPages)
+	    (void) dirFile->ReadAt(pages[page], DirPageSize,
+					page * DirPageSize);
+	else
+	    memset(pages[page], 0, DirPageSize);
+    }
+    return (DirectoryPage *)pages[page];
+}
+
+//----------------------------------------------------------------------
+// Directory::NewPage
+// 	Append an empty page to the directory, and return its number.
+//----------------------------------------------------------------------
+int
+Directory::NewPage()
+{
+    int page = header->numPages++;
+    DirectoryPage *p = GetPage(page);
+
+    p->next = 0;
+    p->used = 0;
+    dirty[page] = TRUE;
+    dirty[0] = TRUE;
+    return page;
 }
 
 //----------------------------------------------------------------------
-// Directory::FindIndex
-// 	Look up file name in directory, and return its location in the table of
-//	directory entries.  Return -1 if the name isn't in the directory.
+// Directory::Bucket
+// 	Return the bucket "name" belongs in.  Buckets below the split
+//	point have already been split, so they use one more bit of the
+//	hash than the rest.
+//----------------------------------------------------------------------
+int
+Directory::Bucket(char *name)
+{
+    unsigned int hash = HashName(name);
+    int low = 1;
+
+    while (low * 2 <= header->numBuckets)
+	low *= 2;
+    int bucket = hash % (2 * low);
+    if (bucket >= header->numBuckets)
+	bucket = hash % low;
+    return bucket;
+}
+
+//----------------------------------------------------------------------
+// Directory::FindEntry
+// 	Look up file name in its bucket.  Return TRUE and fill in the
+//	entry, and the page and offset where it is stored, if found.
 //
 //	"name" -- the file name to look up
 //----------------------------------------------------------------------
-int
-Directory::FindIndex(char *name)
+bool
+Directory::FindEntry(char *name, DirectoryEntry *entry, int *page,
+		     int *offset)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse)
-        {
-            if(table[i].name[FileNameMaxLen] == '\0'){
-                if(!strncmp(table[i].name, name, FileNameMaxLen))
-	                return i;
-            }
-            else
-            {
-                OpenFile *ffln = new OpenFile(Find("FFLN"));
-                char buf[128];
-                ffln->ReadAt(buf, 128, *(int*)table[i].name);
-                delete ffln;
-                if(!strncmp(buf, name, strlen(name)))
-	                return i;
-            }
-        }
-    return -1;		// name not in directory
+    DirectoryPage *p;
+
+    for (int pg = header->bucket[Bucket(name)]; pg != 0; pg = p->next) {
+	p = GetPage(pg);
+	int off = 0;
+	while (off < p->used) {
+	    int length = UnpackEntry(p->entries, off, entry);
+	    if (!strcmp(entry->name, name)) {
+		*page = pg;
+		*offset = off;
+		return TRUE;
+	    }
+	    off += length;
+	}
+    }
+    return FALSE;		// name not in directory
+}
+
+//----------------------------------------------------------------------
+// Directory::Insert
+// 	Pack an entry into the first page of its bucket with room for
+//	it, chaining on a new page if they are all full.  The caller
+//	has checked that the name is not there already.
+//----------------------------------------------------------------------
+void
+Directory::Insert(char *name, int sector, FileType type)
+{
+    int nameLength = strlen(name);
+    int length = EntryHeaderSize + nameLength;
+    int pg = header->bucket[Bucket(name)];
+    DirectoryPage *p = GetPage(pg);
+
+    while (p->used + length > (int)sizeof(p->entries)) {
+	if (p->next == 0) {
+	    p->next = NewPage();
+	    dirty[pg] = TRUE;
+	}
+	pg = p->next;
+	p = GetPage(pg);
+    }
+
+    char *packed = &p->entries[p->used];
+    memcpy(packed, &sector, sizeof(int));
+    packed[sizeof(int)] = (char)type;
+    packed[sizeof(int) + 1] = (char)nameLength;
+    memcpy(&packed[EntryHeaderSize], name, nameLength);
+    p->used += length;
+    dirty[pg] = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::Split
+// 	Grow the hash table by one bucket.  The entries of the next
+//	bucket in line are taken out and put back in, which spreads
+//	them between it and the new bucket.
+//----------------------------------------------------------------------
+void
+Directory::Split()
+{
+    DirectoryPage *p;
+    int low = 1;
+    int pg, total = 0;
+
+    while (low * 2 <= header->numBuckets)
+	low *= 2;
+    int bucket = header->numBuckets - low;
+
+    for (pg = header->bucket[bucket]; pg != 0; pg = p->next) {
+	p = GetPage(pg);
+	total += p->used;
+    }
+    char *saved = new char[total];
+    total = 0;
+    for (pg = header->bucket[bucket]; pg != 0; pg = p->next) {
+	p = GetPage(pg);
+	memcpy(&saved[total], p->entries, p->used);
+	total += p->used;
+	p->used = 0;
+	dirty[pg] = TRUE;
+    }
+
+    header->bucket[header->numBuckets] = NewPage();
+    header->numBuckets++;
+
+    int off = 0;
+    while (off < total) {
+	DirectoryEntry entry;
+	off += UnpackEntry(saved, off, &entry);
+	Insert(entry.name, entry.sector, entry.type);
+    }
+    delete [] saved;
+}
+
+//----------------------------------------------------------------------
+// Directory::GetEntries
+// 	Unpack every entry of the directory into an array, bucket by
+//	bucket.  The caller de-allocates the array.
+//
+//	"count" -- set to the number of entries returned
+//----------------------------------------------------------------------
+DirectoryEntry *
+Directory::GetEntries(int *count)
+{
+    DirectoryEntry *entries = new DirectoryEntry[header->numEntries + 1];
+    DirectoryPage *p;
+
+    *count = 0;
+    for (int bucket = 0; bucket < header->numBuckets; bucket++)
+	for (int pg = header->bucket[bucket]; pg != 0; pg = p->next) {
+	    p = GetPage(pg);
+	    int off = 0;
+	    while (off < p->used)
+		off += UnpackEntry(p->entries, off, &entries[(*count)++]);
+	}
+    ASSERT(*count == header->numEntries);
+    return entries;
 }
 
 //----------------------------------------------------------------------
 // Directory::Find
 // 	Look up file name in directory, and return the disk sector number
-//	where the file's header is stored. Return -1 if the name isn't 
+//	where the file's header is stored. Return -1 if the name isn't
 //	in the directory.
 //
 //	"name" -- the file name to look up
+//	"type" -- if not NULL, set to the type of the file found
 //----------------------------------------------------------------------
 int
-Directory::Find(char *name)
+Directory::Find(char *name, FileType *type)
 {
-    int i = FindIndex(name);
+    DirectoryEntry entry;
+    int page, offset;
 
-    if (i != -1)
-	    return table[i].sector;
+    if (FindEntry(name, &entry, &page, &offset)) {
+	if (type != NULL)
+	    *type = entry.type;
+	return entry.sector;
+    }
     return -1;
 }
 
 int
 Directory::FindDir(char* name)
 {
-    int i = FindIndex(name);
-    if(i != -1)
+    DirectoryEntry entry;
+    int page, offset;
+
+    if (FindEntry(name, &entry, &page, &offset))
     {
-        if(table[i].type != DIRECTORY)
+        if(entry.type != DIRECTORY)
             return -2;
-        return table[i].sector;
+        return entry.sector;
     }
     return -1;
 }
@@ -139,110 +411,101 @@ Directory::FindDir(char* name)
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return TRUE if successful;
-//	return FALSE if the file name is already in the directory, or if
-//	the directory is completely full, and has no more space for
-//	additional file names.
+//	return FALSE if the file name is already in the directory, or
+//	if the name is too long to be stored.
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
 //----------------------------------------------------------------------
 bool
 Directory::Add(char *name, int newSector, FileType filetype)
-{ 
-    if (FindIndex(name) != -1)
+{
+    DirectoryEntry entry;
+    int page, offset;
+
+    if (strlen(name) > FileNameMaxLen)
+	    return FALSE;
+    if (FindEntry(name, &entry, &page, &offset))
 	    return FALSE;
 
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse) {
-            table[i].inUse = TRUE;
-            if(strlen(name) <= FileNameMaxLen)
-            {
-                strncpy(table[i].name, name, FileNameMaxLen);
-                table[i].name[FileNameMaxLen] = '\0';
-            }
-            else
-            {
-                OpenFile *ffln = new OpenFile(Find("FFLN"));
-                *(int*)table[i].name = ffln->Length();
-                table[i].name[FileNameMaxLen] = 1;
-                ffln->WriteAt(name, strlen(name) + 1, ffln->Length());
-                delete ffln;
-            }
-            table[i].sector = newSector;
-            table[i].type = filetype;
-            return TRUE;
-	    }
-    return FALSE;	// no space.  Fix when we have extensible files.
+    Insert(name, newSector, filetype);
+    header->numEntries++;
+    dirty[0] = TRUE;
+
+    if (header->numEntries > header->numBuckets * DirSplitLoad
+	    && header->numBuckets < DirMaxBuckets)
+	Split();
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
 // Directory::Remove
 // 	Remove a file name from the directory.  Return TRUE if successful;
-//	return FALSE if the file isn't in the directory. 
+//	return FALSE if the file isn't in the directory.
 //
 //	"name" -- the file name to be removed
 //----------------------------------------------------------------------
 bool
 Directory::Remove(char *name)
-{ 
-    int i = FindIndex(name);
+{
+    DirectoryEntry entry;
+    int page, offset;
 
-    if (i == -1)
+    if (!FindEntry(name, &entry, &page, &offset))
 	    return FALSE; 		// name not in directory
-    
-    if(table[i].type == DIRECTORY)
-    {
-        OpenFile* dirFile = new OpenFile(table[i].sector);
-        Directory* dir = new Directory(10);
-        dir->FetchFrom(dirFile);
-
-        for(int j = 0; j < 10; j++)
-            if(dir->table[j].inUse)
-                dir->Remove(dir->table[j].name);
-                
-        dir->WriteBack(dirFile);
-        delete dir;
-        delete dirFile;
-    }
 
-    memset(table[i].name, 0, sizeof(table[i].name));
-    table[i].sector = 0;
-    table[i].inUse = FALSE;
-    return TRUE;	
+    // close the gap, so the page's free space stays in one piece
+    DirectoryPage *p = GetPage(page);
+    int length = EntryHeaderSize + strlen(entry.name);
+    memmove(&p->entries[offset], &p->entries[offset + length],
+		p->used - offset - length);
+    p->used -= length;
+    dirty[page] = TRUE;
+
+    header->numEntries--;
+    dirty[0] = TRUE;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
 // Directory::List
-// 	List all the file names in the directory. 
+// 	List all the file names in the directory.
 //----------------------------------------------------------------------
 void
 Directory::List(int depth)
 {
-    for (int i = 0; i < tableSize; i++)
-	    if (table[i].inUse)
+    int count;
+    DirectoryEntry *entries = GetEntries(&count);
+
+    for (int i = 0; i < count; i++)
+    {
+        int j;
+        for(j = 0; j < depth - 1; j++)
+            printf("  ");
+        for(; j < depth; j++)
+            printf("|-");
+        printf("%s\n", entries[i].name);
+        if(entries[i].type == DIRECTORY)
         {
-            int j;
-            for(j = 0; j < depth - 1; j++)
-                printf("  ");
-            for(; j < depth; j++)
-                printf("|-");
-            printf("%s\n", table[i].name);
-            if(table[i].type == DIRECTORY)
-            {
-                Directory* dir = new Directory(10);
-                OpenFile* openfile = new OpenFile(table[i].sector);
-                dir->FetchFrom(openfile);
-                dir->List(depth + 1);
-                delete openfile;
-            }
-        }   
+            Directory* dir = new Directory;
+            OpenFile* openfile = new OpenFile(entries[i].sector);
+            dir->FetchFrom(openfile);
+            dir->List(depth + 1);
+            delete dir;
+            delete openfile;
+        }
+    }
+    delete [] entries;
 }
 
 void Directory::ListCurrent()
 {
-    for (int i = 0; i < tableSize; i++)
-	    if (table[i].inUse)
-            printf("%s\n", table[i].name);
+    int count;
+    DirectoryEntry *entries = GetEntries(&count);
+
+    for (int i = 0; i < count; i++)
+        printf("%s\n", entries[i].name);
+    delete [] entries;
 }
 
 //----------------------------------------------------------------------
@@ -252,29 +515,23 @@ void Directory::ListCurrent()
 //----------------------------------------------------------------------
 void
 Directory::Print()
-{ 
+{
     FileHeader *hdr = new FileHeader;
+    int count;
+    DirectoryEntry *entries = GetEntries(&count);
 
-    printf("Directory contents:\n");
-    for (int i = 0; i < tableSize; i++)
-	if (table[i].inUse) {
-        if(table[i].name[FileNameMaxLen] == '\0')
-	        printf("Name: %s, Sector: %d\n", table[i].name, table[i].sector);
-        else
-        {
-            OpenFile *ffln = new OpenFile(Find("FFLN"));
-            char buf[128];
-            ffln->ReadAt(buf, 128, *(int*)table[i].name);
-            printf("Name: %s, Sector: %d\n", buf, table[i].sector);
-            delete ffln;
-        }
-        if(table[i].type == REGULAR)
+    printf("Directory contents: %d entries, %d buckets, %d pages\n",
+		header->numEntries, header->numBuckets, header->numPages);
+    for (int i = 0; i < count; i++) {
+	printf("Name: %s, Sector: %d\n", entries[i].name, entries[i].sector);
+        if(entries[i].type == REGULAR)
             printf("type: regular file\n");
         else
             printf("type: directory\n");
-	    hdr->FetchFrom(table[i].sector);
-	    hdr->Print();
-	}
+	hdr->FetchFrom(entries[i].sector);
+	hdr->Print();
+    }
     printf("\n");
+    delete [] entries;
     delete hdr;
-}
\ No newline at end of file
+}
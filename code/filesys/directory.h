@@ -1,15 +1,19 @@
-// directory.h 
+// directory.h
 //	Data structures to manage a UNIX-like directory of file names.
-// 
+//
 //      A directory is a table of pairs: <file name, sector #>,
-//	giving the name of each file in the directory, and 
+//	giving the name of each file in the directory, and
 //	where to find its file header (the data structure describing
 //	where to find the file's data blocks) on disk.
 //
+//	On disk, a directory is a hash table of variable length entries,
+//	split into sector-sized pages so that a lookup only has to read
+//	the pages of one bucket, however many files the directory holds.
+//
 //      We assume mutual exclusion is provided by the caller.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
-// All rights reserved.  See copyright.h for copyright notice and limitation 
+// All rights reserved.  See copyright.h for copyright notice and limitation
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
@@ -18,9 +22,15 @@
 #define DIRECTORY_H
 
 #include "openfile.h"
+#include "disk.h"
 
-#define FileNameMaxLen 		9	// for simplicity, we assume 
-					// file names are <= 9 characters long
+#define FileNameMaxLen 		63	// file names are stored inline,
+					// and must fit in a directory page
+
+#define DirPageSize		SectorSize
+#define DirMaxBuckets	((int)((DirPageSize - 3 * sizeof(int)) / sizeof(short)))
+#define DirSplitLoad		4	// average entries per bucket before
+					// the table grows by another bucket
 
 typedef enum{ REGULAR, DIRECTORY } FileType;
 
@@ -28,40 +38,63 @@ typedef enum{ REGULAR, DIRECTORY } FileType;
 // in the directory.  Each entry gives the name of the file, and where
 // the file's header is to be found on disk.
 //
-// Internal data structures kept public so that Directory operations can
-// access them directly.
+// On disk, an entry is packed as the sector number, the type, the
+// length of the name, and the name itself without its trailing '\0';
+// this class is the unpacked version of it.
 
 class DirectoryEntry {
   public:
-    bool inUse;				// Is this directory entry in use?
-    int sector;				// Location on disk to find the 
-					//   FileHeader for this file 
+    int sector;				// Location on disk to find the
+					//   FileHeader for this file
     FileType type;
-    char name[FileNameMaxLen + 1];	// Text name for file, with +1 for 
+    char name[FileNameMaxLen + 1];	// Text name for file, with +1 for
 					// the trailing '\0'
 };
 
+// The first page of a directory file.  The buckets use linear hashing:
+// each time the table gets too full one more bucket is added, by
+// splitting the entries of a single existing bucket in two.
+
+class DirectoryHeader {
+  public:
+    int numEntries;			// Number of files in the directory
+    int numPages;			// Number of pages in the file
+    int numBuckets;			// Number of hash buckets in use
+    short bucket[DirMaxBuckets];	// First page of each bucket
+};
+
+// Every other page of a directory file holds entries of one bucket.
+// When a bucket no longer fits in its page, further pages are
+// chained after it.
+
+class DirectoryPage {
+  public:
+    short next;				// Next page of the bucket, 0 if none
+    short used;				// Bytes of "entries" in use
+    char entries[DirPageSize - 2 * sizeof(short)];
+};
+
 // The following class defines a UNIX-like "directory".  Each entry in
 // the directory describes a file, and where to find it on disk.
 //
 // The directory data structure can be stored in memory, or on disk.
 // When it is on disk, it is stored as a regular Nachos file.
 //
-// The constructor initializes a directory structure in memory; the
-// FetchFrom/WriteBack operations shuffle the directory information
-// from/to disk. 
+// The constructor initializes an empty directory in memory; FetchFrom
+// attaches it to a directory file, after which pages are read in only
+// as they are needed.  WriteBack writes just the pages that changed.
 
 class Directory {
   public:
-    Directory(int size); 		// Initialize an empty directory
-					// with space for "size" files
+    Directory(); 			// Initialize an empty directory
     ~Directory();			// De-allocate the directory
 
     void FetchFrom(OpenFile *file);  	// Init directory contents from disk
-    void WriteBack(OpenFile *file);	// Write modifications to 
+    void WriteBack(OpenFile *file);	// Write modifications to
 					// directory contents back to disk
 
-    int Find(char *name);		// Find the sector number of the 
+    int Find(char *name, FileType *type = NULL);
+					// Find the sector number of the
 					// FileHeader for file: "name"
     int FindDir(char* name);
 
@@ -73,18 +106,33 @@ class Directory {
     void List(int depth = 0);			// Print the names of all the files
 					//  in the directory
     void ListCurrent();
-    
+
     void Print();			// Verbose print of the contents
 					//  of the directory -- all the file
 					//  names and their contents.
 
   private:
-    int tableSize;			// Number of directory entries
-    DirectoryEntry *table;		// Table of pairs: 
-					// <file name, file header location> 
-
-    int FindIndex(char *name);		// Find the index into the directory 
-					//  table corresponding to "name"
+    OpenFile *dirFile;			// Directory file pages are read
+					// from, NULL if there is none yet
+    DirectoryHeader *header;		// Page 0 of the directory
+    char **pages;			// Pages read in so far, or NULL
+    bool *dirty;			// Which pages need writing back
+    int pageCapacity;			// Size of "pages" and "dirty"
+    int diskPages;			// Pages that exist in the file
+
+    void Clear();			// Drop all pages read in
+    void MakeEmpty();			// Set up a directory with no files
+    DirectoryPage *GetPage(int page);	// Page "page", read in if needed
+    int NewPage();			// Append an empty page
+    int Bucket(char *name);		// Bucket that "name" belongs in
+    bool FindEntry(char *name, DirectoryEntry *entry,
+		   int *page, int *offset);
+					// Locate the entry for "name"
+    void Insert(char *name, int sector, FileType type);
+					// Store an entry in its bucket
+    void Split();			// Add one bucket to the table
+    DirectoryEntry *GetEntries(int *count);
+					// Unpack every entry, for listing
 };
 
 #endif // DIRECTORY_H
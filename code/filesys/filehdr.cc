@@ -3,15 +3,21 @@
 //	would be called the i-node).
 //
 //	The file header is used to locate where on disk the 
-//	file's data is stored.  We implement this as a fixed size
-//	table of pointers -- each entry in the table points to the 
-//	disk sector containing that portion of the file data
-//	(in other words, there are no indirect or doubly indirect 
-//	blocks). The table size is chosen so that the file header
-//	will be just big enough to fit in one disk sector, 
+//	file's data is stored.  We implement this as a table of
+//	extents -- each entry in the table describes a run of
+//	consecutive disk sectors holding that portion of the file data.
+//	The first few extents fit in the header sector itself; the
+//	rest are kept in a chain of indirect sectors.  New sectors
+//	are taken by growing the last extent in place when possible,
+//	or else from a run near the end of it, so files stay mostly
+//	contiguous and sequential reads avoid seeks.
+//
+//	A small file keeps its contents in the header sector, in the
+//	space the extents would take; it gets data sectors, and the
+//	contents move there, only when it grows past InlineSize bytes.
 //
 //      Unlike in a real system, we do not keep track of file permissions, 
-//	ownership, last modification date, etc., in the file header. 
+//	ownership, etc., in the file header. 
 //
 //	A file header can be initialized in two ways:
 //	   for a new file, by modifying the in-memory data structure
@@ -29,66 +35,171 @@
 
 void SetTime(int* Time)
 {
-    time_t timep;
-    time(&timep);
+    *Time = (int) time(NULL);
+}
+
+// print a time kept by SetTime, in UTC+8
+static void PrintTime(char* label, int Time)
+{
+    time_t timep = (time_t) Time + 8 * 60 * 60;
     struct tm *p = gmtime(&timep);
-    Time[0] = 1900 + p->tm_year;
-    Time[1] = 1 + p->tm_mon;
-    Time[2] = p->tm_mday;
-    Time[3] = 8 + p->tm_hour;
-    Time[4] = p->tm_min;
+    printf("\n%s%d.%d.%d %d:%02d", label, 1900 + p->tm_year, 1 + p->tm_mon,
+                    p->tm_mday, p->tm_hour, p->tm_min);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FileHeader
+// 	Initialize the in-memory part of a file header.  The block map
+//	starts out empty and is built on demand.
+//----------------------------------------------------------------------
+
+FileHeader::FileHeader()
+{
+    sectorMap = NULL;
+    mapCapacity = 0;
+    mapSectors = -1;
+    mapHdrSector = -1;
+    tailSector = -1;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::~FileHeader
+// 	De-allocate the in-memory block map.
+//----------------------------------------------------------------------
+
+FileHeader::~FileHeader()
+{
+    delete [] sectorMap;
 }
 
 //----------------------------------------------------------------------
 // FileHeader::Allocate
 // 	Initialize a fresh file header for a newly created file.
-//	Allocate data blocks for the file out of the map of free disk blocks.
+//	Allocate data blocks for the file out of the map of free disk blocks,
+//	unless it is small enough to be kept in the header.
 //	Return FALSE if there are not enough free blocks to accomodate
 //	the new file.
 //
 //	"freeMap" is the bit map of free disk sectors
-//	"fileSize" is the bit map of free disk sectors
+//	"fileSize" is the number of bytes in the new file
+//	"nearSector" is where to start looking for free blocks, usually
+//		the sector holding this header
 //----------------------------------------------------------------------
 bool
-FileHeader::Allocate(BitMap *freeMap, int fileSize)
+FileHeader::Allocate(BitMap *freeMap, int fileSize, int nearSector)
 { 
     numBytes = fileSize;
-    numSectors  = divRoundUp(fileSize, SectorSize);
+    numSectors = 0;
+    numExtents = 0;
+    extraSector = -1;
+    mapSectors = 0;			// a new file's map is trivially empty
+    tailSector = -1;
 
-    SetTime(createTime);
-    memcpy(visitTime,createTime,sizeof(createTime));
-    memcpy(modifyTime,createTime,sizeof(createTime));
+    SetTime(&createTime);
+    visitTime = modifyTime = createTime;
 
     memset(path,0,sizeof(path));
     strcpy(path,"/");
 
-    if (freeMap->NumClear() < numSectors)
-	    return FALSE;		// not enough space
-    
-    for (int i = 0; i < numSectors && i < NumDirect; i++)
-        dataSectors[i] = freeMap->Find();
-    extraSector = -1;
-    if(numSectors > NumDirect)
-        extraSector = freeMap->Find();
+    memset(data, 0, InlineSize);
+    if (fileSize <= InlineSize)
+	return TRUE;			// the (empty) contents fit here
+    return AllocateSectors(freeMap, divRoundUp(fileSize, SectorSize), 
+				nearSector);
+}
 
-    int sector = extraSector;
-    int rest = numSectors - NumDirect;
-    while(rest > 0)
-    {
-        ExtraFileHeader *extraHdr = new ExtraFileHeader();
-        for (int i = 0; i < rest && i < NumIndirect; i++)
-            extraHdr->dataSectors[i] = freeMap->Find();
-        extraHdr->extraSector = -1;
-        if(rest > NumIndirect)
-            extraHdr->extraSector = freeMap->Find();
-
-        extraHdr->WriteBack(sector);
-
-        rest -= NumIndirect;
-        sector = extraHdr->extraSector;
-        delete extraHdr;
+//----------------------------------------------------------------------
+// FileHeader::AllocateSectors
+// 	Append "count" data sectors to the end of the file.  The last
+//	extent is grown in place while the sectors after it are free;
+//	the remainder is taken as runs as close after it as possible.
+//	Return FALSE if there are not enough free blocks.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"count" is the number of sectors to add
+//	"hint" is where to look for free blocks if the file is empty
+//----------------------------------------------------------------------
+bool
+FileHeader::AllocateSectors(BitMap *freeMap, int count, int hint)
+{
+    // worst case, every new sector starts an extent of its own
+    if (freeMap->NumClear() < count + divRoundUp(count, NumIndirect))
+	return FALSE;		// not enough space
+    if (count == 0)
+	return TRUE;
+
+    // the block map remembers the tail of the extent chain, where
+    // new extents go
+    if (mapSectors != numSectors)
+	BuildSectorMap();
+    ExtraFileHeader *tail = NULL;
+    if (numExtents > NumDirect) {
+	tail = new ExtraFileHeader;
+	tail->FetchFrom(tailSector);
     }
 
+    while (count > 0) {
+	Extent *last = NULL;
+	if (numExtents > NumDirect)
+	    last = &tail->extents[tail->numExtents - 1];
+	else if (numExtents > 0)
+	    last = &extents[numExtents - 1];
+
+	if (last != NULL) {
+	    // grow the last extent while the following sectors are free
+	    int next = last->start + last->length;
+	    while (count > 0 && next < NumSectors && !freeMap->Test(next)) {
+		freeMap->Mark(next);
+		MapExtent(next++, 1);
+		last->length++;
+		numSectors++;
+		count--;
+	    }
+	    if (count == 0)
+		break;
+	    hint = next;
+	}
+
+	int length;
+	if (numExtents >= NumDirect
+		&& (tail == NULL || tail->numExtents == NumIndirect)) {
+	    // need another sector of indirect extents; take it ahead of
+	    // the data, so it does not split the run that follows
+	    int newSector = freeMap->FindRun(hint, 1, &length);
+	    ASSERT(newSector != -1);
+	    if (tail == NULL) {
+		tail = new ExtraFileHeader;
+		extraSector = newSector;
+	    } else {
+		tail->extraSector = newSector;
+		tail->WriteBack(tailSector);
+	    }
+	    tailSector = newSector;
+	    tail->extraSector = -1;
+	    tail->numExtents = 0;
+	    hint = newSector + 1;
+	}
+
+	int start = freeMap->FindRun(hint, count, &length);
+	ASSERT(start != -1);
+
+	Extent *extent;
+	if (numExtents < NumDirect)
+	    extent = &extents[numExtents];
+	else
+	    extent = &tail->extents[tail->numExtents++];
+	extent->start = start;
+	extent->length = length;
+	MapExtent(start, length);
+	numExtents++;
+	numSectors += length;
+	count -= length;
+    }
+
+    if (tail != NULL) {
+	tail->WriteBack(tailSector);
+	delete tail;
+    }
     return TRUE;
 }
 
@@ -101,29 +212,28 @@ FileHeader::Allocate(BitMap *freeMap, int fileSize)
 void 
 FileHeader::Deallocate(BitMap *freeMap)
 {
-    for (int i = 0; i < NumDirect && i < numSectors; i++) {
-        ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
-        freeMap->Clear((int) dataSectors[i]);
-    }
+    int i, j;
+
+    for (i = 0; i < NumDirect && i < numExtents; i++)
+	for (j = 0; j < extents[i].length; j++) {
+	    ASSERT(freeMap->Test(extents[i].start + j));  // ought to be marked!
+	    freeMap->Clear(extents[i].start + j);
+	}
+
     int sector = extraSector;
-    int rest = numSectors - NumDirect;
-    while(sector != -1)
-    {
-        ExtraFileHeader *extraHdr = new ExtraFileHeader();
-        extraHdr->FetchFrom(sector);
-
-        for (int i = 0; i < NumIndirect && i < rest; i++)
-        {
-            ASSERT(freeMap->Test((int) extraHdr->dataSectors[i]));
-            freeMap->Clear((int) extraHdr->dataSectors[i]);
-        }
-        ASSERT(freeMap->Test(sector));
-        freeMap->Clear(sector);
-        
-        rest -= NumIndirect;
-        sector = extraHdr->extraSector;
-        delete extraHdr;
+    ExtraFileHeader *extraHdr = new ExtraFileHeader();
+    while (sector != -1) {
+	extraHdr->FetchFrom(sector);
+	for (i = 0; i < extraHdr->numExtents; i++)
+	    for (j = 0; j < extraHdr->extents[i].length; j++) {
+		ASSERT(freeMap->Test(extraHdr->extents[i].start + j));
+		freeMap->Clear(extraHdr->extents[i].start + j);
+	    }
+	ASSERT(freeMap->Test(sector));
+	freeMap->Clear(sector);
+	sector = extraHdr->extraSector;
     }
+    delete extraHdr;
 }
 
 //----------------------------------------------------------------------
@@ -136,6 +246,9 @@ void
 FileHeader::FetchFrom(int sector)
 {
     synchDisk->ReadSector(sector, (char *)this);
+    if (sector != mapHdrSector)
+	mapSectors = -1;		// the map is for some other file
+    mapHdrSector = sector;
 }
 
 //----------------------------------------------------------------------
@@ -148,6 +261,7 @@ void
 FileHeader::WriteBack(int sector)
 {
     hdrSector = sector;
+    mapHdrSector = sector;
     synchDisk->WriteSector(sector, (char *)this); 
 }
 
@@ -164,24 +278,68 @@ int
 FileHeader::ByteToSector(int offset)
 {
     int idx = offset / SectorSize;
-    if(idx < NumDirect)
-        return dataSectors[idx];
 
-    idx -= NumDirect;
+    if (mapSectors != numSectors)	// file changed since the map was built
+	BuildSectorMap();
+    ASSERT(idx >= 0 && idx < mapSectors);
+    return sectorMap[idx];
+}
+
+//----------------------------------------------------------------------
+// FileHeader::BuildSectorMap
+// 	Resolve every extent of the file, including those kept in the
+//	chain of indirect sectors, into the in-memory block map.  This
+//	is the only place the chain is read, once per open file.
+//----------------------------------------------------------------------
+void
+FileHeader::BuildSectorMap()
+{
+    int i;
+
+    mapSectors = 0;
+    tailSector = -1;
+    for (i = 0; i < NumDirect && i < numExtents; i++)
+	MapExtent(extents[i].start, extents[i].length);
+
     int sector = extraSector;
     ExtraFileHeader *extraHdr = new ExtraFileHeader();
-    extraHdr->FetchFrom(sector);
-    while(idx >= NumIndirect)
-    {
-        sector = extraHdr->extraSector;
-        extraHdr->FetchFrom(sector);
-        idx -= NumIndirect;
+    while (sector != -1) {
+	extraHdr->FetchFrom(sector);
+	for (i = 0; i < extraHdr->numExtents; i++)
+	    MapExtent(extraHdr->extents[i].start, extraHdr->extents[i].length);
+	tailSector = sector;
+	sector = extraHdr->extraSector;
     }
-    int result = extraHdr->dataSectors[idx];
     delete extraHdr;
-    
-    ASSERT(result != 0);
-    return result;
+    ASSERT(mapSectors == numSectors);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::MapExtent
+// 	Append the sectors of a run to the block map, growing it as
+//	needed.
+//
+//	"start" is the first sector of the run
+//	"length" is the number of sectors in the run
+//----------------------------------------------------------------------
+void
+FileHeader::MapExtent(int start, int length)
+{
+    if (mapSectors < 0)			// map not built; nothing to extend
+	return;
+    if (mapSectors + length > mapCapacity) {
+	int newCapacity = 2 * mapCapacity;
+	if (newCapacity < mapSectors + length)
+	    newCapacity = mapSectors + length;
+	int *newMap = new int[newCapacity];
+	for (int i = 0; i < mapSectors; i++)
+	    newMap[i] = sectorMap[i];
+	delete [] sectorMap;
+	sectorMap = newMap;
+	mapCapacity = newCapacity;
+    }
+    for (int i = 0; i < length; i++)
+	sectorMap[mapSectors++] = start + i;
 }
 
 //----------------------------------------------------------------------
@@ -194,87 +352,79 @@ FileHeader::FileLength()
     return numBytes;
 }
 
-bool FileHeader::Extend(BitMap *freeMap, int extraSize)
+//----------------------------------------------------------------------
+// FileHeader::Extend
+// 	Grow the file by "extraSize" bytes, allocating any data blocks
+//	needed to hold them next to the end of the file.  Return FALSE
+//	(leaving the file unchanged) if there is not enough space.
+//
+//	An inline file stays inline while it fits; otherwise its contents
+//	are moved to the first of its new data sectors.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"extraSize" is the number of bytes to add
+//----------------------------------------------------------------------
+bool
+FileHeader::Extend(BitMap *freeMap, int extraSize)
 {
-    numBytes += extraSize;
-    int numSectorsNew = divRoundUp(numBytes, SectorSize);
-    if (numSectors == numSectorsNew)  // need no more space
+    int numSectorsNew = divRoundUp(numBytes + extraSize, SectorSize);
+    bool wasInline = IsInline();
+    char contents[SectorSize];
+
+    if (numSectors == 0 && numBytes + extraSize <= InlineSize) {
+        numBytes += extraSize;		// still fits in the header
         return TRUE;
-    if (freeMap->NumClear() < numSectorsNew - numSectors)
-        return FALSE;		// not enough space
-    if (numSectorsNew < NumDirect)
-    {
-        for (int i = numSectors; i < numSectorsNew; i++)
-            dataSectors[i] = freeMap->Find();
     }
-    else if(numSectors < NumDirect && numSectorsNew >= NumDirect)
-    {
-        for (int i = numSectors; i < NumDirect; i++)
-            dataSectors[i] = freeMap->Find();
-        extraSector = freeMap->Find();
-        int sector = extraSector;
-        int rest = numSectorsNew - NumDirect;
-        while(rest > 0)
-        {
-            ExtraFileHeader *extraHdr = new ExtraFileHeader();
-            for (int i = 0; i < rest && i < NumIndirect; i++)
-                extraHdr->dataSectors[i] = freeMap->Find();
-            extraHdr->extraSector = -1;
-            if(rest > NumIndirect)
-                freeMap->Find();
-            extraHdr->WriteBack(sector);
-            rest -= NumIndirect;
-            sector = extraHdr->extraSector;
-            delete extraHdr;
-        }
+    if (wasInline) {			// make room for the extents
+        memset(contents, 0, SectorSize);
+        bcopy(data, contents, numBytes);
+        memset(data, 0, InlineSize);
     }
-    else
-    {
-        int rest1 = numSectors - NumDirect;
-        int rest2 = numSectorsNew - NumDirect;
-        int sector = extraSector;
-        ExtraFileHeader *extraHdr = new ExtraFileHeader();
-        extraHdr->FetchFrom(sector);
-        while(rest1 > NumIndirect)
-        {
-            sector = extraHdr->extraSector;
-            extraHdr->FetchFrom(sector);
-            rest1 -= NumIndirect;
-            rest2 -= NumIndirect;
-        }
-
-        for (int i = rest1; i < rest2 && i < NumIndirect; i++)
-            extraHdr->dataSectors[i] = freeMap->Find();
-        extraHdr->extraSector = -1;
-        if(rest2 > NumIndirect)
-            extraHdr->extraSector = freeMap->Find();
-        
-        extraHdr->WriteBack(sector);
-
-        sector = extraHdr->extraSector;
-        rest2 -= NumIndirect;
-        while(rest2 > 0)
-        {
-            extraHdr->FetchFrom(sector);
-
-            for (int i = 0; i < rest2 && i < NumIndirect; i++)
-                extraHdr->dataSectors[i] = freeMap->Find();
-            extraHdr->extraSector = -1;
-            if(rest2 > NumIndirect)
-                extraHdr->extraSector = freeMap->Find();
-
-            extraHdr->WriteBack(sector);
-
-            rest2 -= NumIndirect;
-            sector = extraHdr->extraSector;
-        }
-        delete extraHdr;
+    if (!AllocateSectors(freeMap, numSectorsNew - numSectors, hdrSector)) {
+        if (wasInline)
+            bcopy(contents, data, numBytes);
+        return FALSE;		// not enough space
     }
-
-    numSectors = numSectorsNew;
+    if (wasInline)
+        synchDisk->WriteSector(ByteToSector(0), contents);
+    numBytes += extraSize;
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::IsInline
+// 	Return TRUE if the contents of the file are kept in the header.
+//	An empty file has no contents to keep anywhere, and says FALSE.
+//----------------------------------------------------------------------
+bool
+FileHeader::IsInline()
+{
+    return numSectors == 0 && numBytes > 0;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ReadInline/WriteInline
+// 	Copy part of the contents of an inline file out of, or into, the
+//	header.  The caller has checked the range against the length of
+//	the file, and writes the header back.
+//
+//	"numBytes" -- the number of bytes to copy
+//	"position" -- the offset within the file of the first byte
+//----------------------------------------------------------------------
+void
+FileHeader::ReadInline(char *into, int numBytes, int position)
+{
+    ASSERT(IsInline() && position + numBytes <= this->numBytes);
+    bcopy(&data[position], into, numBytes);
+}
+
+void
+FileHeader::WriteInline(char *from, int numBytes, int position)
+{
+    ASSERT(IsInline() && position + numBytes <= this->numBytes);
+    bcopy(from, &data[position], numBytes);
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Print
 // 	Print the contents of the file header, and the contents of all
@@ -288,57 +438,29 @@ FileHeader::Print()
 
     printf("path: %s\n",path);
     printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
-    for (i = 0; i < NumDirect && i < numSectors; i++)
-        printf("%d ", dataSectors[i]);
-    int sector = extraSector;
-    int rest = numSectors - NumDirect;
-    while(sector != -1)
-    {
-        ExtraFileHeader *extraHdr = new ExtraFileHeader();
-        extraHdr->FetchFrom(sector);
-        for(int i = 0; i < rest && i < NumIndirect; i++)
-            printf("%d ", extraHdr->dataSectors[i]);
-        sector = extraHdr->extraSector;
-        rest -= NumIndirect;
-    }
+    for (i = 0; i < numSectors; i++)
+        printf("%d ", ByteToSector(i * SectorSize));
+    
+    if (IsInline())
+        printf("(inline)");
     
-    printf("\nCreate time:  %d.%d.%d %d:%02d",createTime[0],createTime[1],
-                    createTime[2],createTime[3],createTime[4]);
-    printf("\nLast visit:   %d.%d.%d %d:%02d",visitTime[0],visitTime[1],
-                    visitTime[2],visitTime[3],visitTime[4]);
-    printf("\nLast modify:  %d.%d.%d %d:%02d",modifyTime[0],modifyTime[1],
-                    modifyTime[2],modifyTime[3],modifyTime[4]);
+    PrintTime("Create time:  ", createTime);
+    PrintTime("Last visit:   ", visitTime);
+    PrintTime("Last modify:  ", modifyTime);
     printf("\nFile contents:\n");
-    for (i = k = 0; i < NumDirect && i < numSectors; i++) {
-	    synchDisk->ReadSector(dataSectors[i], data);
+    for (i = k = 0; k < numBytes; i++) {
+	if (IsInline())
+	    bcopy(this->data, data, numBytes);
+	else
+	    synchDisk->ReadSector(ByteToSector(i * SectorSize), data);
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
-	        if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
-		        printf("%c", data[j]);
+	    if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
+		printf("%c", data[j]);
             else
-		        printf("\\%x", (unsigned char)data[j]);
-	    }
+		printf("\\%x", (unsigned char)data[j]);
+	}
         printf("\n"); 
     }
-    sector = extraSector;
-    rest = numSectors - NumDirect;
-    while(sector != -1)
-    {
-        ExtraFileHeader *extraHdr = new ExtraFileHeader();
-        extraHdr->FetchFrom(sector);
-        for(int i = 0; i < rest && i < NumIndirect; i++)
-        {
-            synchDisk->ReadSector(extraHdr->dataSectors[i], data);
-            for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
-                if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
-                    printf("%c", data[j]);
-                else
-                    printf("\\%x", (unsigned char)data[j]);
-	        }
-            printf("\n"); 
-        }
-        rest -= NumIndirect;
-        sector = extraHdr->extraSector;
-    }
 
     delete [] data;
 }
@@ -356,8 +478,8 @@ void FileHeader::SetPath(char* filePath)
     delete filePath;
 }
 
-void FileHeader::UpdateVisitTime(){ SetTime(visitTime); }
-void FileHeader::UpdateModifyTime(){ SetTime(modifyTime); }
+void FileHeader::UpdateVisitTime(){ SetTime(&visitTime); }
+void FileHeader::UpdateModifyTime(){ SetTime(&modifyTime); }
 
 void
 ExtraFileHeader::FetchFrom(int sector)
@@ -19,30 +19,59 @@
 #include "time.h"
 
 #define FilePathLen 24
-#define NumDirect 	((SectorSize - 19 * sizeof(int) - FilePathLen * sizeof(char)) / sizeof(int))
-#define NumIndirect 	((SectorSize - 1 * sizeof(int)) / sizeof(int))
-#define MaxFileSize 	(NumDirect * SectorSize)
+#define NumDirect 	((SectorSize - 8 * sizeof(int) - FilePathLen * sizeof(char)) / sizeof(Extent))
+#define InlineSize	(NumDirect * sizeof(Extent))
+					// bytes of data the header can hold
+					// in place of its extents
+#define NumIndirect 	((SectorSize - 2 * sizeof(int)) / sizeof(Extent))
+
+// The following class defines an "extent" -- a run of "length"
+// consecutive disk sectors beginning at sector "start".  Keeping a
+// file's data in a few long runs lets sequential access stream through
+// the track buffer instead of paying a seek for every sector.
+
+class Extent {
+  public:
+    int start;				// first sector of the run
+    int length;				// number of sectors in the run
+};
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
-// The file header is organized as a simple table of pointers to
-// data blocks. 
+// The file header is organized as a table of extents, each describing
+// a run of contiguous data blocks.  The first NumDirect extents are
+// kept in the header itself; the rest are kept in a chain of
+// ExtraFileHeader sectors starting at "extraSector".
+//
+// A file of at most InlineSize bytes has no data sectors at all: its
+// contents are kept in the header, where the extents would be.  Such
+// a file is read with the header alone; it is moved out to data
+// sectors when it grows too big.
 //
 // The file header data structure can be stored in memory or on disk.
 // When it is on disk, it is stored in a single sector -- this means
 // that we assume the size of this data structure to be the same
-// as one disk sector.  Without indirect addressing, this
-// limits the maximum file length to just under 4K bytes.
+// as one disk sector.
 //
-// There is no constructor; rather the file header can be initialized
-// by allocating blocks for the file (if it is a new file), or by
-// reading it from disk.
+// The constructor only sets up the in-memory block map; the file
+// header itself is initialized by allocating blocks for the file (if
+// it is a new file), or by reading it from disk.
+//
+// While in memory, the header also keeps a fully resolved map from
+// block index to disk sector, built from the extents the first time
+// it is needed, so that ByteToSector never has to go back to the
+// indirect sectors on disk.
 
 class FileHeader {
   public:
-    bool Allocate(BitMap *bitMap, int fileSize);// Initialize a file header, 
-						//  including allocating space 
-						//  on disk for the file data
+    FileHeader();			// Initialize an empty block map
+    ~FileHeader();			// De-allocate the block map
+
+    bool Allocate(BitMap *bitMap, int fileSize, int nearSector = 0);
+					// Initialize a file header, 
+					//  including allocating space 
+					//  on disk for the file data,
+					//  preferably just after "nearSector"
     void Deallocate(BitMap *bitMap);  		// De-allocate this file's 
 						//  data blocks
 
@@ -59,6 +88,11 @@ class FileHeader {
 
     bool Extend(BitMap *freeMap, int extraSize);
 
+    bool IsInline();			// Are the contents in the header?
+    void ReadInline(char *into, int numBytes, int position);
+    void WriteInline(char *from, int numBytes, int position);
+					// Copy contents of an inline file
+
     void Print();			// Print the contents of the file.
 
     int GetHdrSector();
@@ -73,12 +107,36 @@ class FileHeader {
     int numSectors;			// Number of data sectors in the file
     int hdrSector;    // sector number of the header
     char path[FilePathLen];      // sector of directory on the path
-    int createTime[5];
-    int visitTime[5];
-    int modifyTime[5];
-    int extraSector;  // sector for indirect index, -1 if there isn't one
-    int dataSectors[NumDirect];		// Disk sector numbers for each data 
-					// block in the file
+    int createTime;			// Times, in seconds since 1970
+    int visitTime;
+    int modifyTime;
+    int extraSector;  // sector for indirect extents, -1 if there isn't one
+    int numExtents;			// Number of extents in the file,
+					// including those in the extra sectors
+    union {
+	Extent extents[NumDirect];	// The first extents of the file
+	char data[InlineSize];		// Or, if there are no data
+					// sectors, the contents
+    };
+
+    // The fields below are kept in memory only; they must stay after
+    // the on-disk fields, since only the first SectorSize bytes of
+    // the object are read from or written to disk.
+    int *sectorMap;			// sectorMap[i] is the disk sector
+					// of data block i
+    int mapCapacity;			// Entries allocated in sectorMap
+    int mapSectors;			// Entries filled in, -1 if the map
+					// has to be rebuilt
+    int mapHdrSector;			// Header sector the map belongs to
+    int tailSector;			// Last sector of the extent chain,
+					// -1 if there is none
+
+    bool AllocateSectors(BitMap *freeMap, int count, int hint);
+					// Append "count" data sectors to
+					// the file, as few runs as possible
+    void BuildSectorMap();		// Resolve all extents into sectorMap
+    void MapExtent(int start, int length);
+					// Append a run of sectors to sectorMap
 };
 
 class ExtraFileHeader{
@@ -86,8 +144,9 @@ public:
   void FetchFrom(int sectorNumber);
   void WriteBack(int sectorNumber);
 
-  int extraSector;  // sector for indirect index, -1 if there isn't one
-  int dataSectors[NumIndirect];
+  int extraSector;  // sector for the next indirect extents, -1 if there isn't one
+  int numExtents;   // number of extents used in this sector
+  Extent extents[NumIndirect];
 };
 
 #endif // FILEHDR_H
@@ -21,12 +21,18 @@
 //	The file system assumes that the bitmap and directory files are
 //	kept "open" continuously while Nachos is running.
 //
+//	To keep seeks short, sectors are allocated by block groups (cf.
+//	filesys.h): a file's header is put in the group of the directory
+//	holding it, and its data is allocated starting from its header.
+//
 //	For those operations (such as Create, Remove) that modify the
 //	directory and/or bitmap, if the operation succeeds, the changes
-//	are written immediately back to disk (the two files are kept
-//	open during all this time).  If the operation fails, and we have
-//	modified part of the directory and/or bitmap, we simply discard
-//	the changed version, without writing it back to disk.
+//	are written back to disk (the two files are kept open during all
+//	this time), as one journal transaction (cf. journal.h), so that
+//	either all of them or none reach the disk.  If the operation
+//	fails, and we have modified part of the directory and/or bitmap,
+//	we simply discard the changed version, without writing it back
+//	to disk.
 //
 // 	Our implementation at this point has the following restrictions:
 //
@@ -35,9 +41,9 @@
 //	   files cannot be bigger than about 3KB in size
 //	   there is no hierarchical directory structure, and only a limited
 //	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//	   only the metadata is journaled; if Nachos exits in the
+//	    middle of writing a file, the file may hold part old and
+//	    part new data
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -58,12 +64,13 @@
 #define FreeMapSector 		0
 #define DirectorySector 	1
 
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number 
-// of files that can be loaded onto the disk.
+// Initial file sizes for the bitmap and directory; a directory starts
+// out as its header page and a single bucket page, and grows a page at
+// a time as files are added to it.
 #define FreeMapFileSize 	(NumSectors / BitsInByte)
-#define NumDirEntries 		10
-#define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
+#define DirectoryFileSize 	(2 * DirPageSize)
+
+static int LookupName(int dirSector, char *name, FileType *type);
 
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
@@ -87,7 +94,7 @@ FileSystem::FileSystem(bool format)
             synchDisk->WriteSector(i, emptySector);
 
         BitMap *freeMap = new BitMap(NumSectors);
-        Directory *directory = new Directory(NumDirEntries);
+        Directory *directory = new Directory;
         FileHeader *mapHdr = new FileHeader;
         FileHeader *dirHdr = new FileHeader;
 
@@ -97,6 +104,8 @@ FileSystem::FileSystem(bool format)
         // (make sure no one else grabs these!)
         freeMap->Mark(FreeMapSector);	    
         freeMap->Mark(DirectorySector);
+        for (int i = JournalStart; i < JournalStart + JournalSectors; i++)
+            freeMap->Mark(i);
 
         // Second, allocate space for the data blocks containing the contents
         // of the directory and bitmap files.  There better be enough space!
@@ -129,6 +138,7 @@ FileSystem::FileSystem(bool format)
         DEBUG('f', "Writing bitmap and directory back to disk.\n");
         freeMap->WriteBack(freeMapFile);	 // flush changes to disk
         directory->WriteBack(directoryFile);
+        journal->Format();
 
         if (DebugIsEnabled('f')) {
             freeMap->Print();
@@ -139,11 +149,12 @@ FileSystem::FileSystem(bool format)
             delete mapHdr; 
             delete dirHdr;
         }
-        
-        Create("FFLN",0);   // file for long name
-        Create("PIPE",0);
     }
     else {
+        // finish whatever was committed to the journal but may not have
+        // been written in place when Nachos last stopped
+        journal->Recover();
+
         // if we are not formatting the disk, just open the files representing
         // the bitmap and directory; these are left open while Nachos is running
         freeMapFile = new OpenFile(FreeMapSector);
@@ -193,10 +204,15 @@ FileSystem::Create(char *name, int initialSize)
 
     DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
 
+    journal->Begin();
     Path* path = new Path(name);
     directory = path->GetDirectory(directoryFile);
     if(directory == -1 || directory == -2)
+    {
+        journal->End();
         return;
+    }
+    int dirSector = path->GetDirSector();
 
     FileType fileType = REGULAR;
     if(initialSize == -1)
@@ -210,7 +226,8 @@ FileSystem::Create(char *name, int initialSize)
     else {	
         freeMap = new BitMap(NumSectors);
         freeMap->FetchFrom(freeMapFile);
-        sector = freeMap->Find();	// find a sector to hold the file header
+        // find a sector to hold the file header
+        sector = AllocateHeader(freeMap, dirSector, fileType);
     	if (sector == -1) 		
             success = FALSE;		// no free block for file header 
         else
@@ -223,18 +240,30 @@ FileSystem::Create(char *name, int initialSize)
                 hdr = new FileHeader;
                 // NOTE: freeMap read back again
                 freeMap->FetchFrom(freeMapFile);
-                if (!hdr->Allocate(freeMap, initialSize))
+                if (!hdr->Allocate(freeMap, initialSize, sector))
                     success = FALSE;	// no space on disk for data
                 else {	
                     success = TRUE;
                     // everthing worked, flush all changes back to disk
                     // hdr->SetPath(path->GetPath());
                     hdr->WriteBack(sector);
+                    if (fileType == DIRECTORY)
+                    {
+                        // the sectors may hold anything; give the new
+                        // directory its empty header and bucket
+                        Directory *newDir = new Directory;
+                        OpenFile *newDirFile = new OpenFile(sector);
+                        newDir->WriteBack(newDirFile);
+                        delete newDirFile;
+                        delete newDir;
+                    }
                     OpenFile *temp = path->GetDirOpenFile(directoryFile);
                     directory->WriteBack(temp);
                     if(temp != directoryFile)
                         delete temp;
     	    	    freeMap->WriteBack(freeMapFile);    
+                    nameCache->Enter(dirSector, path->GetName(),
+                                        sector, fileType);
                 }
             delete hdr;
 	        }
@@ -243,9 +272,47 @@ FileSystem::Create(char *name, int initialSize)
     }
     delete directory;
     delete path;
+    journal->End();
     return success;
 }
 
+//----------------------------------------------------------------------
+// FileSystem::AllocateHeader
+// 	Find a sector for the header of a new file, and mark it in use.
+//	A regular file gets the first free sector of its directory's
+//	group, or the nearest one after it.  A directory is spread out
+//	to the group with the most free sectors, so that there is room
+//	left near it for the files that will go into it.  Return -1 if
+//	the disk is full.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"dirSector" is the header sector of the directory holding the file
+//	"type" is what the new file is
+//----------------------------------------------------------------------
+
+int
+FileSystem::AllocateHeader(BitMap *freeMap, int dirSector, FileType type)
+{
+    int group = dirSector / SectorsPerGroup;
+    int length;
+
+    if (type == DIRECTORY) {
+        int bestFree = 0;
+        for (int k = 0; k < NumGroups; k++) {
+            int g = (group + 1 + k) % NumGroups;	// siblings go apart
+            int numFree = 0;
+            for (int i = 0; i < SectorsPerGroup; i++)
+                if (!freeMap->Test(g * SectorsPerGroup + i))
+                    numFree++;
+            if (numFree > bestFree) {
+                bestFree = numFree;
+                group = g;
+            }
+        }
+    }
+    return freeMap->FindRun(group * SectorsPerGroup, 1, &length);
+}
+
 //----------------------------------------------------------------------
 // FileSystem::Open
 // 	Open a file for reading and writing.  
@@ -258,21 +325,25 @@ FileSystem::Create(char *name, int initialSize)
 OpenFile *
 FileSystem::Open(char *name)
 { 
-    Directory *directory = new Directory(NumDirEntries);
     OpenFile *openFile = NULL;
+    FileType type;
     int sector;
 
     DEBUG('f', "Opening file %s\n", name);
 
+    // resolved through the name cache, without reading any directory
+    // if the path was looked up before
     Path* path = new Path(name);
-    directory = path->GetDirectory(directoryFile);
-    if(directory == -1 || directory == -2)
-        return;
+    int dirSector = path->GetDirSector();
+    if(dirSector < 0)
+    {
+        delete path;
+        return NULL;
+    }
 
-    sector = directory->Find(path->GetName()); 
+    sector = LookupName(dirSector, path->GetName(), &type); 
     if (sector >= 0) 		
 	    openFile = new OpenFile(sector);	// name was found in directory 
-    delete directory;
     delete path;
     return openFile;				// return NULL if not found
 }
@@ -298,21 +369,26 @@ FileSystem::Remove(char *name)
     FileHeader *fileHdr;
     int sector;
     
-    directory = new Directory(NumDirEntries);
-
+    journal->Begin();
     Path* path = new Path(name);
     directory = path->GetDirectory(directoryFile);
     if(directory == -1 || directory == -2)
+    {
+        journal->End();
         return;
+    }
+    int dirSector = path->GetDirSector();
     
     sector = directory->Find(path->GetName());
     if (sector == -1) {
        delete directory;
+       journal->End();
        return FALSE;			 // file not found 
     }
     if (synchDisk->visiter[sector] != 0)
     {
         delete directory;
+        journal->End();
         return FALSE;
     }
     fileHdr = new FileHeader;
@@ -332,12 +408,113 @@ FileSystem::Remove(char *name)
     if(temp != directoryFile)
         delete temp;       // flush to disk
 
+    // the name is gone, and if it was a directory, so is everything
+    // that was cached under its header sector
+    nameCache->Enter(dirSector, path->GetName(), -1, REGULAR);
+    nameCache->Purge(sector);
+
     delete fileHdr;
     delete directory;
     delete freeMap;
+    journal->End();
     return TRUE;
 } 
 
+//----------------------------------------------------------------------
+// FileSystem::Rename
+// 	Move a file to a new name, possibly in another directory.  Only
+//	the directory entries change: the file keeps its header and its
+//	data, so this takes the same time however big the file is.
+//
+//	If "replace" is set, a file that already has the new name is
+//	removed in the same transaction, so after a crash either the
+//	old file or the renamed one has the name.
+//
+//	Return TRUE if the file was renamed; FALSE if it does not exist,
+//	the new name is taken already (by a directory, or an open file,
+//	if "replace" is set), or there is no room for the new name.
+//
+//	"from" -- the text name of the file to be renamed
+//	"to" -- the new name of the file
+//	"replace" -- may a file called "to" be removed?
+//----------------------------------------------------------------------
+bool
+FileSystem::Rename(char *from, char *to, bool replace)
+{
+    Directory *fromDir, *toDir;
+    FileType type, oldType;
+    int sector, oldSector;
+    bool success;
+
+    DEBUG('f', "Renaming file %s to %s\n", from, to);
+
+    journal->Begin();
+    Path* fromPath = new Path(from);
+    Path* toPath = new Path(to);
+    int fromSector = fromPath->GetDirSector();
+    int toSector = toPath->GetDirSector();
+    if (fromSector < 0 || toSector < 0) {
+        delete fromPath;
+        delete toPath;
+        journal->End();
+        return FALSE;
+    }
+
+    // when both names are in the same directory, there is only one
+    // copy of it to change
+    fromDir = fromPath->GetDirectory(directoryFile);
+    if (toSector == fromSector)
+        toDir = fromDir;
+    else
+        toDir = toPath->GetDirectory(directoryFile);
+
+    sector = fromDir->Find(fromPath->GetName(), &type);
+    oldSector = toDir->Find(toPath->GetName(), &oldType);
+    if (sector == -1 || (oldSector != -1 && (!replace
+            || oldType == DIRECTORY || oldSector == sector
+            || synchDisk->visiter[oldSector] != 0)))
+        success = FALSE;		// nothing to move, or name taken
+    else {
+        if (oldSector != -1)
+            toDir->Remove(toPath->GetName());
+        fromDir->Remove(fromPath->GetName());
+        success = toDir->Add(toPath->GetName(), sector, type);
+        if (success) {
+            if (oldSector != -1) {	// free the file that was replaced
+                FileHeader *oldHdr = new FileHeader;
+                BitMap *freeMap = new BitMap(NumSectors);
+                oldHdr->FetchFrom(oldSector);
+                freeMap->FetchFrom(freeMapFile);
+                oldHdr->Deallocate(freeMap);
+                freeMap->Clear(oldSector);
+                freeMap->WriteBack(freeMapFile);
+                delete freeMap;
+                delete oldHdr;
+            }
+            OpenFile *temp = toPath->GetDirOpenFile(directoryFile);
+            toDir->WriteBack(temp);
+            if (temp != directoryFile)
+                delete temp;
+            if (toDir != fromDir) {
+                temp = fromPath->GetDirOpenFile(directoryFile);
+                fromDir->WriteBack(temp);
+                if (temp != directoryFile)
+                    delete temp;
+            }
+            nameCache->Enter(fromSector, fromPath->GetName(), -1, REGULAR);
+            nameCache->Enter(toSector, toPath->GetName(), sector, type);
+        }
+    }
+
+    if (toDir != fromDir)
+        delete toDir;
+    delete fromDir;
+    delete fromPath;
+    delete toPath;
+    journal->End();
+    return success;
+}
+
 //----------------------------------------------------------------------
 // FileSystem::List
 // 	List all the files in the file system directory.
@@ -345,7 +522,7 @@ FileSystem::Remove(char *name)
 void
 FileSystem::List()
 {
-    Directory *directory = new Directory(NumDirEntries);
+    Directory *directory = new Directory;
 
     directory->FetchFrom(directoryFile);
     directory->List();
@@ -367,7 +544,7 @@ FileSystem::Print()
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
     BitMap *freeMap = new BitMap(NumSectors);
-    Directory *directory = new Directory(NumDirEntries);
+    Directory *directory = new Directory;
 
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
@@ -383,6 +560,8 @@ FileSystem::Print()
     directory->FetchFrom(directoryFile);
     directory->Print();
 
+    nameCache->Print();
+
     delete bitHdr;
     delete dirHdr;
     delete freeMap;
@@ -505,12 +684,65 @@ bool FileSystem::mkdir(char* name)
     return true;
 }
 
+// mv only changes directory entries; moving a file onto an existing
+// file replaces it, in the same transaction as the rename, and moving
+// it onto a directory puts it there.
 bool FileSystem::mv(char* src, char* dst)
 {
-    cp(src, dst);
-    rm(src);
+    char srcPath[MAX_PATH_LENGTH];
+    char dstPath[MAX_PATH_LENGTH];
+    strcpy(srcPath, currentPath);
+    strcpy(dstPath, currentPath);
+    ChangePath(srcPath, src);
+    ChangePath(dstPath, dst);
+    char* srcName = srcPath + 2;
+    char* dstName = dstPath + 2;
+
+    Path* path = new Path(srcName);
+    int dirSector = path->GetDirSector();
+    FileType type;
+    int sector = -1;
+    if(dirSector >= 0)
+        sector = LookupName(dirSector, path->GetName(), &type);
+    delete path;
+    if(sector < 0)
+    {
+        printf("mv: cannot stat '%s': No such file or directory\n", srcName);
+        return false;
+    }
+
+    path = new Path(dstName);
+    dirSector = path->GetDirSector();
+    sector = -1;
+    if(dirSector >= 0)
+        sector = LookupName(dirSector, path->GetName(), &type);
+    delete path;
+    if(sector >= 0 && type == DIRECTORY)
+    {
+        Path* srcParts = new Path(srcName);
+        strcat(dstPath, "/");
+        strcat(dstPath, srcParts->GetName());
+        delete srcParts;
+    }
+
+    // a file can't replace itself, nor a directory go into itself
+    int length = strlen(srcPath);
+    if(strncmp(srcPath, dstPath, length) == 0
+        && (dstPath[length] == '/' || dstPath[length] == '\0'))
+    {
+        printf("mv: cannot move '%s' to '%s'\n", srcName, dstName);
+        return false;
+    }
+    if(Rename(srcName, dstName, TRUE) == false)
+    {
+        printf("mv: cannot move '%s' to '%s'\n", srcName, dstName);
+        return false;
+    }
+    return true;
 }
 
+// cp copies a track's worth of sectors at a time, into a file that has
+// all its sectors allocated up front when it is created.
 bool FileSystem::cp(char* src, char* dst)
 {
     char srcPath[MAX_PATH_LENGTH];
@@ -525,21 +757,57 @@ bool FileSystem::cp(char* src, char* dst)
     if(srcFile == NULL)
     {
         printf("cp: cannot stat '%s': No such file or directory\n", srcName);
-        return;
+        return false;
     }
+    int length = srcFile->Length();
     OpenFile* dstFile = Open(dstName);
     if(dstFile == NULL)
     {
-        Create(dstName, 0);
+        Create(dstName, length);
         dstFile = Open(dstName);
     }
+    if(dstFile == NULL)
+    {
+        printf("cp: cannot create '%s'\n", dstName);
+        delete srcFile;
+        return false;
+    }
+    if(dstFile->GetHdrSector() == srcFile->GetHdrSector())
+    {
+        delete srcFile;			// copying a file onto itself
+        delete dstFile;
+        return true;
+    }
 
-    char c;
-    while(srcFile->Read(&c,1) != 0)
-        dstFile->Write(&c,1);
+    char* buffer = new char[CopyChunkSize];
+    int srcSector = srcFile->GetHdrSector();
+    int dstSector = dstFile->GetHdrSector();
+    // both files stay locked for the whole copy, so take the locks in
+    // the order of their header sectors, as any other copy does
+    if(srcSector < dstSector)
+    {
+        synchDisk->StartRead(srcSector);
+        synchDisk->StartWrite(dstSector);
+    }
+    else
+    {
+        synchDisk->StartWrite(dstSector);
+        synchDisk->StartRead(srcSector);
+    }
+    srcFile->Update();
+    dstFile->Update();
+    for(int position = 0; position < length; position += CopyChunkSize)
+    {
+        int numBytes = srcFile->ReadAt(buffer, CopyChunkSize, position);
+        dstFile->WriteAt(buffer, numBytes, position);
+    }
+    synchDisk->FinishWrite(dstSector);
+    synchDisk->FinishRead(srcSector);
+    delete [] buffer;
 
     delete srcFile;
     delete dstFile;
+    return true;
 }
 
 bool FileSystem::rm(char* name)
@@ -594,17 +862,71 @@ char* Path::GetPath()
     return filePath;
 }
 
-Directory* Path::GetDirectory(OpenFile* directoryFile)
-{       
-    Directory *directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
+//----------------------------------------------------------------------
+// LookupName
+// 	Look up one path component in the directory whose header is at
+//	"dirSector", going to the disk only if the name cache does not
+//	know the answer.  Return the header sector of the file, or -1.
+//
+//	"type" -- set to the type of the file found
+//----------------------------------------------------------------------
+
+static int
+LookupName(int dirSector, char *name, FileType *type)
+{
+    int sector;
+
+    if (nameCache->Lookup(dirSector, name, &sector, type))
+        return sector;
+
+    Directory *directory = new Directory;
+    OpenFile *dirFile = new OpenFile(dirSector);
+    directory->FetchFrom(dirFile);
+    *type = REGULAR;
+    sector = directory->Find(name, type);
+    delete directory;
+    delete dirFile;
+
+    nameCache->Enter(dirSector, name, sector, *type);
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// Path::GetDirSector
+// 	Walk the path from the root, through the name cache, and return
+//	the header sector of the directory holding the last component.
+//	Return -1 if some directory on the way does not exist, and -2 if
+//	it is not a directory.
+//----------------------------------------------------------------------
+
+int Path::GetDirSector()
+{
+    int sector = DirectorySector;
     for(int i = 0; i < path.size() - 1; i++)
     {
-        int sector = directory->FindDir(path[i]);
+        FileType type;
+        sector = LookupName(sector, path[i], &type);
         if(sector == -1)
             return -1;
-        if(sector == -2)
+        if(type != DIRECTORY)
             return -2;
+    }
+    return sector;
+}
+
+Directory* Path::GetDirectory(OpenFile* directoryFile)
+{       
+    int sector = GetDirSector();
+    if(sector == -1)
+        return -1;
+    if(sector == -2)
+        return -2;
+
+    Directory *directory = new Directory;
+    if(sector == DirectorySector)
+        directory->FetchFrom(directoryFile);
+    else
+    {
         OpenFile* openfile = new OpenFile(sector);
         directory->FetchFrom(openfile);
         delete openfile;
@@ -614,21 +936,12 @@ Directory* Path::GetDirectory(OpenFile* directoryFile)
 
 OpenFile* Path::GetDirOpenFile(OpenFile* directoryFile)
 {
-    Directory *directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    for(int i = 0; i < path.size() - 1; i++)
-    {
-        int sector = directory->FindDir(path[i]);
-        if(sector == -1)
-            return NULL;
-        OpenFile* openfile = new OpenFile(sector);
-        if(i == path.size() - 2)
-            return openfile;
-        directory->FetchFrom(openfile);
-        delete openfile;
-    }
-    delete directory;
-    return directoryFile;
+    int sector = GetDirSector();
+    if(sector < 0)
+        return NULL;
+    if(sector == DirectorySector)
+        return directoryFile;
+    return new OpenFile(sector);
 }
 
 char* Path::GetName()
@@ -40,6 +40,8 @@
 #include "directory.h"
 #include <vector>
 
+class BitMap;
+
 #define MAX_PATH_LENGTH 80
 #define PATH_PAD "/ahh"
 
@@ -48,6 +50,8 @@ class Path{
 	Path(char* name);
 	~Path();
 	char* Path::GetPath();
+	int GetDirSector();		// Header sector of the directory
+					// holding the last component
 	Directory* GetDirectory(OpenFile* directoryFile);
 	OpenFile* GetDirOpenFile(OpenFile* directoryFile);
 	char* GetName();
@@ -98,6 +102,12 @@ class FileSystem {
 
     bool Remove(char *name);  		// Delete a file (UNIX unlink)
 
+    bool Rename(char *from, char *to, bool replace = FALSE);
+					// Give a file another name, in
+					// the same or another directory,
+					// replacing any file called "to"
+					// if "replace" (UNIX rename)
+
     void List();			// List all the files in the file system
 
     void Print();			// List all the files and their contents
@@ -124,8 +134,23 @@ class FileSystem {
 	OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
 	char currentPath[MAX_PATH_LENGTH];
+
+    int AllocateHeader(BitMap *freeMap, int dirSector, FileType type);
+					// Pick and mark the header sector
+					// of a new file in "dirSector"
 };
 
+// The disk is divided into groups of adjacent tracks.  A file's header
+// goes in the group of its directory, and its data after the header,
+// so that walking a directory tree stays within few tracks; each new
+// directory goes to the group with the most free space.
+#define TracksPerGroup	4
+#define SectorsPerGroup	(TracksPerGroup * SectorsPerTrack)
+#define NumGroups	(NumTracks / TracksPerGroup)
+
+#define CopyChunkSize	(SectorsPerTrack * SectorSize)
+					// bytes cp moves per ReadAt/WriteAt
+
 #endif // FILESYS
 
 #endif // FS_H
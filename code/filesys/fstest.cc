@@ -20,6 +20,7 @@
 #include "thread.h"
 #include "disk.h"
 #include "stats.h"
+#include "pipe.h"
 
 #define TransferSize 	10 	// make it small, just to be difficult
 
@@ -197,38 +198,37 @@ PerformanceTest()
     }
 }
 
-Semaphore *full = new Semaphore("full",0);
-Semaphore *empty = new Semaphore("empty",1);
+//----------------------------------------------------------------------
+// PipeTest
+// 	Pass words typed on the console to another thread, through an
+//	in-memory pipe; the reader prints them.  End with end of file.
+//----------------------------------------------------------------------
 
-void
-Pipe1()
+static void
+Pipe1(int arg)
 {
-    while(true){
-        OpenFile* pipe = fileSystem->Open("PIPE");
-        char str[100];
-        memset(str,0,sizeof(str));
-        full->P();
-        pipe->Read(str,100);
-        printf("%s\n",str);
-        empty->V();
-        delete pipe;
+    PipeBuffer* pipe = (PipeBuffer*) arg;
+    char str[100];
+    int len;
+
+    while ((len = pipe->Read(str, sizeof(str) - 1)) > 0) {
+        str[len] = '\0';
+        printf("%s\n", str);
     }
+    if (pipe->CloseEnd(FALSE))
+        delete pipe;
 }
 
 void
 PipeTest()
 {
+    PipeBuffer* pipe = new PipeBuffer();
     Thread* thread1 = new Thread("Thread1");
-    thread1->Fork(Pipe1,1);
-
-    while(true){
-        OpenFile* pipe = fileSystem->Open("PIPE");
-        char str[100];
-        memset(str,0,sizeof(str));
-        scanf("%s",str);
-        empty->P();
-        pipe->Write(str,strlen(str) + 1);
-        full->V();
+    thread1->Fork(Pipe1, (void *) pipe);
+
+    char str[100];
+    while (scanf("%99s", str) == 1)
+        pipe->Write(str, strlen(str));
+    if (pipe->CloseEnd(TRUE))
         delete pipe;
-    }
 }
\ No newline at end of file
@@ -0,0 +1,318 @@
+// journal.cc
+//	Routines to make changes to the file system metadata atomic, by
+//	writing them to a journal on disk before they are written in place.
+//
+//	The sectors written by a transaction are pinned in the buffer
+//	cache (cf. synchdisk.h) until their group is committed, so that
+//	none of them can reach its place on disk first.  After the commit
+//	they are ordinary dirty sectors again, and are written whenever
+//	the cache likes; only before the journal is overwritten by the
+//	next commit do we make sure they have all been written.
+//
+//	Begin, End and Checkpoint may be called by any thread; the lock
+//	protects the counts, and "committing" keeps transactions from
+//	starting while a group is being written out.  Log is called by
+//	the disk cache with interrupts disabled, and never waits.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "journal.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize an empty journal.  Until Format or Recover find out
+//	that the disk has a journal, transactions do nothing.
+//----------------------------------------------------------------------
+
+Journal::Journal()
+{
+    enabled = FALSE;
+    count = installCount = outstanding = 0;
+    for (int i = 0; i < JournalMaxUsers; i++) {
+	user[i] = NULL;
+	depth[i] = 0;
+    }
+    committing = FALSE;
+    commitThreshold = JournalMaxSectors / 2;
+    lock = new Lock("journal lock");
+    changed = new Condition("journal changed");
+}
+
+//----------------------------------------------------------------------
+// Journal::~Journal
+// 	De-allocate the journal.  Anything not committed is lost.
+//----------------------------------------------------------------------
+
+Journal::~Journal()
+{
+    delete lock;
+    delete changed;
+}
+
+//----------------------------------------------------------------------
+// Journal::Format
+// 	Write an empty journal header to a newly formatted disk.  The
+//	caller has to keep the journal sectors out of the free map.
+//----------------------------------------------------------------------
+
+void
+Journal::Format()
+{
+    WriteHeader(0);
+    enabled = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Journal::Recover
+// 	Called when the disk is mounted, before anything else reads it.
+//	If the header lists a committed group, its sectors may not all
+//	have been written in place; copy every one of them there from the
+//	journal (doing it twice does no harm), and empty the journal.
+//
+//	A disk formatted without a journal has no header; we leave it
+//	alone, and do without one.
+//----------------------------------------------------------------------
+
+void
+Journal::Recover()
+{
+    char header[SectorSize];
+    char data[SectorSize];
+    JournalHeader *hdr = (JournalHeader *) header;
+
+    synchDisk->ReadSector(JournalStart, header);
+    if (hdr->magic != JournalMagic) {
+	printf("Disk has no journal; format it with -f to get one.\n");
+	return;
+    }
+    enabled = TRUE;
+    if (hdr->count == 0)
+	return;
+
+    DEBUG('f', "Recovering %d sectors from the journal\n", hdr->count);
+    for (int i = 0; i < hdr->count; i++) {
+	synchDisk->ReadSector(JournalStart + 1 + i, data);
+	synchDisk->WriteSector(hdr->sector[i], data);
+    }
+    for (int i = 0; i < hdr->count; i++)
+	synchDisk->Sync(hdr->sector[i]);
+    WriteHeader(0);
+}
+
+//----------------------------------------------------------------------
+// Journal::Begin
+// 	Start a transaction for the current thread, or go one level
+//	deeper into the one it is in.  Wait until the journal is sure to
+//	have room for what the transaction writes, committing the group
+//	so far if nobody else is going to.
+//----------------------------------------------------------------------
+
+void
+Journal::Begin()
+{
+    int i;
+
+    if (!enabled)
+	return;
+    lock->Acquire();
+    if ((i = FindUser()) != -1) {
+	depth[i]++;
+	lock->Release();
+	return;
+    }
+    while (committing || outstanding == JournalMaxUsers
+	    || count + (outstanding + 1) * JournalOpSectors > JournalMaxSectors) {
+	if (!committing && outstanding == 0)
+	    Commit();
+	else
+	    changed->Wait(lock);
+    }
+    for (i = 0; user[i] != NULL; i++)
+	;
+    user[i] = currentThread;
+    depth[i] = 1;
+    outstanding++;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::End
+// 	End the current thread's transaction (or one level of it).  The
+//	group is committed once no transaction is going on, and it has
+//	grown big enough to be worth a trip to the journal; until then,
+//	more transactions can join it.
+//----------------------------------------------------------------------
+
+void
+Journal::End()
+{
+    int i;
+
+    if (!enabled)
+	return;
+    lock->Acquire();
+    i = FindUser();
+    ASSERT(i != -1);
+    if (--depth[i] == 0) {
+	user[i] = NULL;
+	outstanding--;
+	if (outstanding == 0 && count >= commitThreshold)
+	    Commit();
+	changed->Broadcast(lock);	// there may be room for others
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::InTransaction
+// 	Return TRUE if the current thread is in a transaction, so the
+//	sectors it writes belong to the journal.
+//----------------------------------------------------------------------
+
+bool
+Journal::InTransaction()
+{
+    return enabled && FindUser() != -1;
+}
+
+//----------------------------------------------------------------------
+// Journal::Log
+// 	Add a sector to the group being built, unless it is there already
+//	(a sector written by many transactions is journaled once).  The
+//	cache has pinned it.
+//----------------------------------------------------------------------
+
+void
+Journal::Log(int sectorNumber)
+{
+    for (int i = 0; i < count; i++)
+	if (sector[i] == sectorNumber)
+	    return;
+    ASSERT(count < JournalMaxSectors);	// transaction too big
+    sector[count++] = sectorNumber;
+}
+
+//----------------------------------------------------------------------
+// Journal::Checkpoint
+// 	Commit the group so far, and write it in place, leaving the
+//	journal empty; called before Nachos stops.  If a transaction is
+//	still going on, it cannot be committed, and is lost.
+//----------------------------------------------------------------------
+
+void
+Journal::Checkpoint()
+{
+    if (!enabled)
+	return;
+    lock->Acquire();
+    if (!committing && outstanding == 0) {
+	Commit();
+	committing = TRUE;
+	lock->Release();
+	Install();
+	lock->Acquire();
+	committing = FALSE;
+	changed->Broadcast(lock);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::FindUser
+// 	Return the slot of the current thread's transaction, or -1 if it
+//	is not in one.
+//----------------------------------------------------------------------
+
+int
+Journal::FindUser()
+{
+    for (int i = 0; i < JournalMaxUsers; i++)
+	if (user[i] == currentThread)
+	    return i;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Write the group to the journal with one run of adjacent sectors,
+//	then the header that makes it count.  Called with the lock held
+//	and no transaction going on; the lock is let go meanwhile.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit()
+{
+    char data[SectorSize];
+
+    if (count == 0)
+	return;
+    committing = TRUE;
+    lock->Release();
+
+    Install();				// the journal is about to be reused
+    for (int i = 0; i < count; i++) {
+	synchDisk->ReadSector(sector[i], data);
+	synchDisk->WriteSector(JournalStart + 1 + i, data);
+    }
+    for (int i = 0; i < count; i++)
+	synchDisk->Sync(JournalStart + 1 + i);	// the first writes them all
+    WriteHeader(count);
+
+    // committed: the sectors may go in place now
+    for (int i = 0; i < count; i++) {
+	synchDisk->Unpin(sector[i]);
+	install[i] = sector[i];
+    }
+    installCount = count;
+    stats->numJournalCommits++;
+    stats->numJournalSectors += count;
+    count = 0;
+
+    lock->Acquire();
+    committing = FALSE;
+    changed->Broadcast(lock);
+}
+
+//----------------------------------------------------------------------
+// Journal::Install
+// 	Make sure the sectors of the last group committed are in place,
+//	and empty the journal, so that recovery will not copy whatever
+//	is written there next.
+//----------------------------------------------------------------------
+
+void
+Journal::Install()
+{
+    if (installCount == 0)
+	return;
+    for (int i = 0; i < installCount; i++)
+	synchDisk->Sync(install[i]);
+    WriteHeader(0);
+    installCount = 0;
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteHeader
+// 	Write the journal header, saying that the first "committed"
+//	sectors of the group are committed, and wait until it is on disk.
+//----------------------------------------------------------------------
+
+void
+Journal::WriteHeader(int committed)
+{
+    char header[SectorSize];
+    JournalHeader *hdr = (JournalHeader *) header;
+
+    ASSERT(sizeof(JournalHeader) <= SectorSize);
+    memset(header, 0, sizeof(header));
+    hdr->magic = JournalMagic;
+    hdr->count = committed;
+    for (int i = 0; i < committed; i++)
+	hdr->sector[i] = sector[i];
+    synchDisk->WriteSector(JournalStart, header);
+    synchDisk->Sync(JournalStart);
+}
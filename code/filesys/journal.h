@@ -0,0 +1,109 @@
+// journal.h
+//	Data structures for a write-ahead journal of file system metadata.
+//
+//	An operation that changes the file system (Create, Remove, Rename,
+//	extending a file) writes several sectors: file headers, the free
+//	map, directory pages.  If Nachos stops half way through, the disk
+//	is left inconsistent.  So each such operation is made a
+//	transaction, by bracketing it with Begin and End; every sector
+//	written in between is kept in the buffer cache, and not written
+//	to its place on disk, until the transaction is committed.
+//
+//	A commit first writes the new contents of all the sectors to the
+//	journal, a region at the end of the disk, and then the journal
+//	header listing where they belong.  Once the header is on disk the
+//	transaction has happened: if Nachos stops before the sectors are
+//	written in place, Recover copies them there from the journal the
+//	next time the disk is mounted.
+//
+//	Transactions are committed in groups.  Operations that overlap
+//	(from different threads) or follow each other closely share one
+//	commit, and so one sequential write of the journal; the sectors
+//	are written in place whenever the cache gets to it ("checkpoint"),
+//	and at the latest just before the journal is reused.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "disk.h"
+#include "synch.h"
+
+#define JournalSectors		(2 * SectorsPerTrack)
+					// the last two tracks of the disk
+#define JournalStart		(NumSectors - JournalSectors)
+					// header; the sectors follow it
+#define JournalMaxSectors	((int)((SectorSize - sizeof(int) \
+				- sizeof(short)) / sizeof(short)))
+					// sectors one commit can hold
+#define JournalOpSectors	16	// most sectors one transaction
+					// may write
+#define JournalMaxUsers		(JournalMaxSectors / JournalOpSectors)
+					// transactions open at once
+#define JournalMagic		0x6a726e6c
+
+// The journal header, as it is stored on disk in sector JournalStart.
+// "count" is 0 when there is nothing to recover.
+
+class JournalHeader {
+  public:
+    int magic;				// JournalMagic, if the disk has
+					// a journal at all
+    short count;			// Sectors in the committed group
+    short sector[JournalMaxSectors];	// Where each of them belongs
+};
+
+// The following class defines the journal.  Transactions may nest:
+// a thread that is already in one just goes on with it.
+
+class Journal {
+  public:
+    Journal();				// Initialize the journal; the disk
+					// is not looked at until Format
+					// or Recover
+    ~Journal();
+
+    void Format();			// Set up an empty journal on a new
+					// disk
+    void Recover();			// Redo the last committed group, if
+					// it was not written in place yet
+
+    void Begin();			// Start a transaction
+    void End();				// End it; it may be committed
+					// later, together with others
+    bool InTransaction();		// Is the current thread in one?
+    void Log(int sector);		// Called by the disk cache when a
+					// sector is written in a transaction
+
+    void Checkpoint();			// Commit everything, and write it
+					// all in place
+
+  private:
+    bool enabled;			// Does the disk have a journal?
+    int count;				// Sectors logged, not committed yet
+    int sector[JournalMaxSectors];	// Which sectors they are
+    int installCount;			// Committed sectors not known to
+    int install[JournalMaxSectors];	// be in place yet, and which
+    int outstanding;			// Transactions not ended yet
+    Thread *user[JournalMaxUsers];	// Threads in those transactions
+    int depth[JournalMaxUsers];		// How deeply each one is nested
+    bool committing;			// Is a commit going on?
+    int commitThreshold;		// Sectors logged before a group is
+					// committed without being asked to
+    Lock *lock;				// Enforce mutual exclusive access
+    Condition *changed;			// Wait in Begin for room or for a
+					// commit to finish
+
+    int FindUser();			// Slot of the current thread, or -1
+    void Commit();			// Write the group to the journal
+    void Install();			// Write committed sectors in place,
+					// so the journal can be reused
+    void WriteHeader(int committed);	// Write (and wait for) the header
+};
+
+#endif // JOURNAL_H
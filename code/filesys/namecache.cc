@@ -0,0 +1,230 @@
+// namecache.cc
+//	Routines to remember the result of recent path lookups.
+//
+//	The entries are allocated once, in the constructor.  Used entries
+//	are found through a hash table on <parent, name>; all entries are
+//	on a circular LRU list, with the unused ones at its tail, so the
+//	entry to (re)use next is always lru.lruPrev.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "utility.h"
+#include "namecache.h"
+
+//----------------------------------------------------------------------
+// NameCache::NameCache
+// 	Initialize an empty name cache.
+//
+//	"size" is the number of names the cache remembers
+//----------------------------------------------------------------------
+
+NameCache::NameCache(int size)
+{
+    int i;
+
+    this->size = size;
+    entries = new NameCacheEntry[size];
+    numBuckets = size;
+    buckets = new NameCacheEntry *[numBuckets];
+    for (i = 0; i < numBuckets; i++)
+	buckets[i] = NULL;
+
+    lru.lruPrev = lru.lruNext = &lru;
+    for (i = 0; i < size; i++) {
+	entries[i].parent = -1;
+	entries[i].hashNext = NULL;
+	entries[i].lruPrev = entries[i].lruNext = &entries[i];
+	MoveToBack(&entries[i]);
+    }
+    hits = misses = 0;
+}
+
+//----------------------------------------------------------------------
+// NameCache::~NameCache
+// 	De-allocate the name cache.
+//----------------------------------------------------------------------
+
+NameCache::~NameCache()
+{
+    delete [] entries;
+    delete [] buckets;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Lookup
+// 	Look up "name" in the directory whose header is at "parent".
+//	Return FALSE if the cache does not know; otherwise return TRUE,
+//	with "sector" set to -1 if the name is known not to exist.
+//----------------------------------------------------------------------
+
+bool
+NameCache::Lookup(int parent, char *name, int *sector, FileType *type)
+{
+    NameCacheEntry *entry = FindEntry(parent, name);
+
+    if (entry == NULL) {
+	misses++;
+	return FALSE;
+    }
+    hits++;
+    MoveToFront(entry);
+    *sector = entry->sector;
+    *type = entry->type;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Enter
+// 	Remember what "name" refers to in directory "parent", replacing
+//	whatever was known about it before.
+//
+//	"sector" is the header of the file, -1 if there is no such name
+//----------------------------------------------------------------------
+
+void
+NameCache::Enter(int parent, char *name, int sector, FileType type)
+{
+    NameCacheEntry *entry;
+
+    if (strlen(name) > FileNameMaxLen)
+	return;				// could never be in a directory
+
+    entry = FindEntry(parent, name);
+    if (entry == NULL) {
+	entry = lru.lruPrev;		// least recently used, or unused
+	if (entry->parent != -1)
+	    Unhash(entry);
+	entry->parent = parent;
+	strcpy(entry->name, name);
+	int bucket = Hash(parent, name);
+	entry->hashNext = buckets[bucket];
+	buckets[bucket] = entry;
+    }
+    entry->sector = sector;
+    entry->type = type;
+    MoveToFront(entry);
+}
+
+//----------------------------------------------------------------------
+// NameCache::Invalidate
+// 	Forget what was known about "name" in directory "parent".
+//----------------------------------------------------------------------
+
+void
+NameCache::Invalidate(int parent, char *name)
+{
+    NameCacheEntry *entry = FindEntry(parent, name);
+
+    if (entry != NULL) {
+	Unhash(entry);
+	MoveToBack(entry);
+    }
+}
+
+//----------------------------------------------------------------------
+// NameCache::Purge
+// 	Forget every name in directory "parent", because the directory
+//	is going away and its header sector may be reused.
+//----------------------------------------------------------------------
+
+void
+NameCache::Purge(int parent)
+{
+    for (int i = 0; i < size; i++)
+	if (entries[i].parent == parent) {
+	    Unhash(&entries[i]);
+	    MoveToBack(&entries[i]);
+	}
+}
+
+//----------------------------------------------------------------------
+// NameCache::Print
+// 	Print how often lookups were answered by the cache.
+//----------------------------------------------------------------------
+
+void
+NameCache::Print()
+{
+    printf("Name cache: hits %d, misses %d\n", hits, misses);
+}
+
+//----------------------------------------------------------------------
+// NameCache::Hash
+// 	Pick the bucket for <parent, name>.
+//----------------------------------------------------------------------
+
+int
+NameCache::Hash(int parent, char *name)
+{
+    unsigned int hash = 2166136261u ^ (unsigned int)parent;
+
+    for (; *name != '\0'; name++)
+	hash = (hash ^ (unsigned char)*name) * 16777619u;
+    return hash % numBuckets;
+}
+
+//----------------------------------------------------------------------
+// NameCache::FindEntry
+// 	Return the entry for <parent, name>, or NULL if there is none.
+//----------------------------------------------------------------------
+
+NameCacheEntry *
+NameCache::FindEntry(int parent, char *name)
+{
+    NameCacheEntry *entry;
+
+    for (entry = buckets[Hash(parent, name)]; entry != NULL;
+					entry = entry->hashNext)
+	if (entry->parent == parent && !strcmp(entry->name, name))
+	    return entry;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Unhash
+// 	Take a used entry out of its hash chain, and mark it unused.
+//----------------------------------------------------------------------
+
+void
+NameCache::Unhash(NameCacheEntry *entry)
+{
+    NameCacheEntry **link = &buckets[Hash(entry->parent, entry->name)];
+
+    while (*link != entry)
+	link = &(*link)->hashNext;
+    *link = entry->hashNext;
+    entry->hashNext = NULL;
+    entry->parent = -1;
+}
+
+//----------------------------------------------------------------------
+// NameCache::MoveToFront
+// NameCache::MoveToBack
+// 	Move an entry to the most recently used end of the LRU list,
+//	or to the end where it is the first to be replaced.
+//----------------------------------------------------------------------
+
+void
+NameCache::MoveToFront(NameCacheEntry *entry)
+{
+    entry->lruPrev->lruNext = entry->lruNext;
+    entry->lruNext->lruPrev = entry->lruPrev;
+    entry->lruNext = lru.lruNext;
+    entry->lruPrev = &lru;
+    lru.lruNext->lruPrev = entry;
+    lru.lruNext = entry;
+}
+
+void
+NameCache::MoveToBack(NameCacheEntry *entry)
+{
+    entry->lruPrev->lruNext = entry->lruNext;
+    entry->lruNext->lruPrev = entry->lruPrev;
+    entry->lruPrev = lru.lruPrev;
+    entry->lruNext = &lru;
+    lru.lruPrev->lruNext = entry;
+    lru.lruPrev = entry;
+}
@@ -0,0 +1,84 @@
+// namecache.h
+//	Data structures to remember the result of recent path lookups.
+//
+//	Resolving a path means looking up one name after another, each
+//	in the directory found by the previous one.  The name cache maps
+//	<directory header sector, name> to the header sector and type of
+//	what the name refers to, so that a path that was looked up
+//	before can be resolved without reading any directory from disk.
+//	Names known not to exist are cached too ("negative" entries).
+//
+//	The cache is only a hint for reading; whoever changes a directory
+//	has to keep the cache up to date, with Enter, Invalidate or Purge.
+//
+//	We assume mutual exclusion is provided by the caller.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef NAMECACHE_H
+#define NAMECACHE_H
+
+#include "directory.h"
+
+#define NameCacheSize		64	// Names remembered at once
+
+// One remembered lookup.  Entries are chained both in their hash
+// bucket and in least-recently-used order.
+
+class NameCacheEntry {
+  public:
+    int parent;				// Sector of the directory's header,
+					// -1 if the entry is unused
+    char name[FileNameMaxLen + 1];	// Name looked up in "parent"
+    int sector;				// Sector of the header the name
+					// refers to, -1 if there is none
+    FileType type;			// What the name refers to
+
+    NameCacheEntry *hashNext;		// Next entry in the same bucket
+    NameCacheEntry *lruPrev;		// Used more recently than us
+    NameCacheEntry *lruNext;		// Used less recently than us
+};
+
+// The following class defines the name cache itself.  When it is
+// full, the entry that was used least recently is replaced.
+
+class NameCache {
+  public:
+    NameCache(int size);		// Initialize an empty cache with
+					// room for "size" names
+    ~NameCache();			// De-allocate the cache
+
+    bool Lookup(int parent, char *name, int *sector, FileType *type);
+					// Return TRUE if the result of
+					// looking up "name" is known; then
+					// "sector" is -1 if it does not exist
+    void Enter(int parent, char *name, int sector, FileType type);
+					// Remember a lookup; "sector" is -1
+					// if "name" does not exist
+    void Invalidate(int parent, char *name);
+					// Forget about one name
+    void Purge(int parent);		// Forget all names in a directory
+
+    void Print();			// Print the hit ratio
+
+  private:
+    NameCacheEntry *entries;		// All the entries, used or not
+    int size;				// Number of entries
+    NameCacheEntry **buckets;		// Hash chains of used entries
+    int numBuckets;
+    NameCacheEntry lru;			// Head of the LRU list; unused
+					// entries are kept at its tail
+    int hits, misses;			// Lookups that were (not) cached
+
+    int Hash(int parent, char *name);
+    NameCacheEntry *FindEntry(int parent, char *name);
+    void Unhash(NameCacheEntry *entry);	// Take an entry out of its bucket
+    void MoveToFront(NameCacheEntry *entry);
+    void MoveToBack(NameCacheEntry *entry);
+};
+
+#endif // NAMECACHE_H
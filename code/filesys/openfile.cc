@@ -7,6 +7,15 @@
 //	Also as in UNIX, for convenience, we keep the file header in
 //	memory while the file is open.
 //
+//	Bytes appended to the end of the file with Write are held in a
+//	buffer, without allocating disk space for them.  When the buffer
+//	is written out, the file is extended once for all of it, so that
+//	a burst of small appends gets one contiguous run of sectors, and
+//	the header and free map are written once rather than per append.
+//	The buffer belongs to the file, not to one open of it, so every
+//	OpenFile of the file reads the appended bytes from it, and counts
+//	them in its length.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -19,6 +28,56 @@
 #include <strings.h>
 #endif
 
+static PendingAppends *openAppends = NULL;	// one for each open file
+
+//----------------------------------------------------------------------
+// GetAppends
+// 	Return the appends of the file whose header is at "sector",
+//	starting with none if the file is not open yet.
+//----------------------------------------------------------------------
+
+static PendingAppends *
+GetAppends(int sector)
+{
+    PendingAppends *appends;
+
+    for (appends = openAppends; appends != NULL; appends = appends->next)
+        if (appends->sector == sector)
+            break;
+    if (appends == NULL) {
+        appends = new PendingAppends;
+        appends->sector = sector;
+        appends->refs = 0;
+        appends->buffer = NULL;
+        appends->start = appends->count = 0;
+        appends->next = openAppends;
+        openAppends = appends;
+    }
+    appends->refs++;
+    return appends;
+}
+
+//----------------------------------------------------------------------
+// PutAppends
+// 	Forget the appends of a file when its last OpenFile is closed.
+//	By then they must have been written out.
+//----------------------------------------------------------------------
+
+static void
+PutAppends(PendingAppends *appends)
+{
+    if (--appends->refs > 0)
+        return;
+    ASSERT(appends->count == 0);
+
+    PendingAppends **link = &openAppends;
+    while (*link != appends)
+        link = &(*link)->next;
+    *link = appends->next;
+    delete [] appends->buffer;
+    delete appends;
+}
+
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
@@ -32,16 +91,29 @@ OpenFile::OpenFile(int sector)
     hdr = new FileHeader;
     hdr->FetchFrom(sector);
     seekPosition = 0;
+    expectedPosition = 0;
+    readAheadWindow = 0;
+    readAheadNext = 0;
+    appends = GetAppends(sector);
     synchDisk->visiter[sector]++;
 }
 
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
 // 	Close a Nachos file, de-allocating any in-memory data structures.
+//	If this is the last open of the file, bytes still held back by
+//	appends are written first.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile()
 {
+    if (appends->refs == 1 && appends->count > 0) {
+        synchDisk->StartWrite(hdr->GetHdrSector());
+        Update();
+        FlushAppends();
+        synchDisk->FinishWrite(hdr->GetHdrSector());
+    }
+    PutAppends(appends);
     synchDisk->visiter[hdr->GetHdrSector()]--;
     delete hdr;
 }
@@ -66,7 +138,9 @@ OpenFile::Seek(int position)
 //	Return the number of bytes actually written or read, and as a
 //	side effect, increment the current position within the file.
 //
-//	Implemented using the more primitive ReadAt/WriteAt.
+//	Implemented using the more primitive ReadAt/WriteAt; except that
+//	a Write at the end of the file, where nothing is allocated yet,
+//	only goes into the append buffer, until that fills up.
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
@@ -96,7 +170,20 @@ OpenFile::Write(char *into, int numBytes)
 
     Update();
 
-    int result = WriteAt(into, numBytes, seekPosition);
+    int result;
+    int end = Length();
+    if (seekPosition == end && numBytes > 0 && numBytes <= AppendBufferSize) {
+        if (appends->count + numBytes > AppendBufferSize)
+            FlushAppends();		// full; start over
+        if (appends->buffer == NULL)
+            appends->buffer = new char[AppendBufferSize];
+        if (appends->count == 0)
+            appends->start = seekPosition;
+        bcopy(into, &appends->buffer[appends->count], numBytes);
+        appends->count += numBytes;
+        result = numBytes;
+    } else
+        result = WriteAt(into, numBytes, seekPosition);
     currentThread->Yield();
     seekPosition += result;
 
@@ -117,7 +204,8 @@ OpenFile::Write(char *into, int numBytes)
 //
 //	For ReadAt:
 //	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
+//	   request, but we only copy the part we are interested in.  Bytes
+//	   still in the append buffer are copied from there.
 //	For WriteAt:
 //	   We must first read in any sectors that will be partially written,
 //	   so that we don't overwrite the unmodified portion.  We then copy
@@ -134,8 +222,8 @@ OpenFile::Write(char *into, int numBytes)
 int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
-    int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
+    int fileLength = Length();
+    int i, firstSector, lastSector, numSectors, onDisk;
     char *buf;
 
     hdr->UpdateVisitTime();
@@ -148,8 +236,26 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
     DEBUG('f', "Reading %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
 
+    // the bytes past the end of the file on disk are in the append
+    // buffer
+    onDisk = numBytes;
+    if (appends->count > 0 && position + numBytes > appends->start) {
+        int from = (position > appends->start) ? position
+                                                 : appends->start;
+        bcopy(&appends->buffer[from - appends->start],
+              &into[from - position], position + numBytes - from);
+        onDisk = from - position;
+        if (onDisk == 0)
+            return numBytes;
+    }
+
+    if (hdr->IsInline()) {		// no data sectors to read
+        hdr->ReadInline(into, onDisk, position);
+        return numBytes;
+    }
+
     firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
+    lastSector = divRoundDown(position + onDisk - 1, SectorSize);
     numSectors = 1 + lastSector - firstSector;
 
     // read in all the full and partial sectors that we need
@@ -159,8 +265,10 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
 					&buf[(i - firstSector) * SectorSize]);
 
     // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
+    bcopy(&buf[position - (firstSector * SectorSize)], into, onDisk);
     delete [] buf;
+
+    ReadAhead(position, onDisk);
     return numBytes;
 }
 
@@ -172,6 +280,10 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
     bool firstAligned, lastAligned;
     char *buf;
 
+    if (appends->count > 0) {
+        FlushAppends();			// keep the writes in order
+        fileLength = hdr->FileLength();
+    }
     hdr->UpdateVisitTime();
 
     if (numBytes <= 0)
@@ -180,6 +292,8 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
         position = fileLength;
     if ((position + numBytes) > fileLength)
     {
+        // the new sectors, the header and the free map change together
+        journal->Begin();
         OpenFile *freeMapFile = new OpenFile(0);
         BitMap *freeMap = new BitMap(NumSectors);
         freeMap->FetchFrom(freeMapFile);
@@ -191,10 +305,18 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
     
         delete freeMapFile;
         delete freeMap;
+        journal->End();
     } 
     DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
 
+    if (hdr->IsInline()) {		// the data goes in the header
+        hdr->WriteInline(from, numBytes, position);
+        hdr->UpdateModifyTime();
+        hdr->WriteBack(hdr->GetHdrSector());
+        return numBytes;
+    }
+
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
     numSectors = 1 + lastSector - firstSector;
@@ -205,11 +327,13 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
     lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
 
 // read in first and last sector, if they are to be partially modified
+// (the file has been extended to cover them already)
     if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
+        synchDisk->ReadSector(hdr->ByteToSector(firstSector * SectorSize),
+					buf);
     if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
-				SectorSize, lastSector * SectorSize);	
+        synchDisk->ReadSector(hdr->ByteToSector(lastSector * SectorSize),
+				&buf[(lastSector - firstSector) * SectorSize]);
 
 // copy in the bytes we want to change 
     bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
@@ -226,19 +350,90 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::ReadAhead
+// 	Called after every ReadAt.  While the file is read sequentially,
+//	keep the sectors after the request on their way into the buffer
+//	cache, so the next ReadAt finds them there.  The window starts at
+//	one sector and doubles with each sequential read, up to
+//	MaxReadAhead; any other access pattern turns read-ahead off.
+//
+//	"position", "numBytes" -- the part of the file just read
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadAhead(int position, int numBytes)
+{
+    if (position != expectedPosition) {
+        readAheadWindow = 0;		// not sequential
+        readAheadNext = 0;
+    } else if (readAheadWindow == 0)
+        readAheadWindow = 1;
+    else if (readAheadWindow < MaxReadAhead)
+        readAheadWindow *= 2;
+    expectedPosition = position + numBytes;
+
+    if (readAheadWindow == 0)
+        return;
+    int first = divRoundUp(position + numBytes, SectorSize);
+    int last = first + readAheadWindow - 1;
+    int fileSectors = divRoundUp(hdr->FileLength(), SectorSize);
+    if (last >= fileSectors)
+        last = fileSectors - 1;
+    if (first < readAheadNext)
+        first = readAheadNext;		// asked for already
+    for (int i = first; i <= last; i++)
+        synchDisk->ReadAhead(hdr->ByteToSector(i * SectorSize));
+    if (last >= first)
+        readAheadNext = last + 1;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::FlushAppends
+// 	Write out the bytes held back by appends.  WriteAt extends the
+//	file by all of them at once.
+//----------------------------------------------------------------------
+
+void
+OpenFile::FlushAppends()
+{
+    int count = appends->count;
+
+    appends->count = 0;			// so WriteAt does not come back here
+    if (count > 0)
+        WriteAt(appends->buffer, count, appends->start);
+}
+
 //----------------------------------------------------------------------
 // OpenFile::Length
-// 	Return the number of bytes in the file.
+// 	Return the number of bytes in the file, counting those appended
+//	but not written yet.
 //----------------------------------------------------------------------
 
 int
 OpenFile::Length() 
 { 
-    return hdr->FileLength(); 
+    int length = hdr->FileLength();
+
+    if (appends->count > 0 && appends->start + appends->count > length)
+        length = appends->start + appends->count;
+    return length;
 }
 
 void
 OpenFile::Update()
 {
     hdr->FetchFrom(hdr->GetHdrSector());
-}
\ No newline at end of file
+}
+
+//----------------------------------------------------------------------
+// OpenFile::GetHdrSector
+// 	Return the disk sector holding the header of this file, so the
+//	file can be opened again by someone else.
+//----------------------------------------------------------------------
+
+int
+OpenFile::GetHdrSector()
+{
+    return hdr->GetHdrSector();
+}
@@ -51,6 +51,8 @@ class OpenFile {
 		return numWritten;
 		}
 
+    void Seek(int position) { currentOffset = position; }
+    int GetSeekPosition() { return currentOffset; }
     int Length() { Lseek(file, 0, 2); return Tell(file); }
     
   private:
@@ -60,6 +62,13 @@ class OpenFile {
 
 #else // FILESYS
 class FileHeader;
+class PendingAppends;
+
+#define MaxReadAhead	16		// most sectors read ahead of a
+					// sequential reader
+#define AppendBufferSize 4096		// bytes appended with Write that
+					// are kept before space is
+					// allocated for them (a track)
 
 class OpenFile {
   public:
@@ -88,9 +97,41 @@ class OpenFile {
 	void Update();
 
 	int GetSeekPosition() { return seekPosition; }
+	int GetHdrSector();		// Sector of this file's header
   private:
     FileHeader *hdr;			// Header for this file 
     int seekPosition;			// Current position within the file
+
+    int expectedPosition;		// Where a sequential ReadAt would
+					// start next
+    int readAheadWindow;		// Sectors to keep read ahead, 0 if
+					// the reads are not sequential
+    int readAheadNext;			// First sector not yet read ahead
+
+    PendingAppends *appends;		// Bytes appended to the file, not
+					// yet written; shared by all its
+					// OpenFiles
+
+    void ReadAhead(int position, int numBytes);
+					// Read ahead of a sequential reader
+    void FlushAppends();		// Write the appended bytes, with
+					// one allocation for all of them
+};
+
+// Bytes appended to the end of a file with Write, which have no disk
+// space yet.  There is one of these for each file that is open, found
+// by its header sector, so every OpenFile of the file sees the same
+// appended bytes.
+
+class PendingAppends {
+  public:
+    int sector;				// Header sector of the file
+    int refs;				// OpenFiles of the file
+    char *buffer;			// The bytes; NULL until the first
+					// append
+    int start;				// Where they go in the file
+    int count;				// How many there are
+    PendingAppends *next;		// Next open file with appends
 };
 
 #endif // FILESYS
@@ -1,25 +1,41 @@
-// synchdisk.cc 
-//	Routines to synchronously access the disk.  The physical disk 
+// synchdisk.cc
+//	Routines to synchronously access the disk.  The physical disk
 //	is an asynchronous device (disk requests return immediately, and
 //	an interrupt happens later on).  This is a layer on top of
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	The physical disk can only handle one operation at a time, so
+//	requests are queued; each thread waits on a semaphore of its own
+//	request.  Whenever the disk finishes a request, the interrupt
+//	handler picks the next one to start, according to the scheduling
+//	policy, so the order of service need not be the order of arrival.
+//
+//	Sectors read or written are kept in a small write-back buffer
+//	cache, and every request reads into, or writes from, cache
+//	entries.  Dirty sectors are written when they are replaced, or on
+//	Flush; either way, the run of adjacent dirty sectors around them
+//	goes to the disk in one multi-sector request.  At most one request
+//	per sector is outstanding, so requests for the same sector are
+//	never reordered.  Sectors written in a journal transaction are
+//	pinned: they stay dirty in the cache until the journal says they
+//	may be written (cf. journal.h).  Read-ahead requests are not made by
+//	any thread in particular, and are only started when no thread is
+//	waiting for the disk.  The queue and the cache are shared with the
+//	interrupt handler, so they are only touched with interrupts
+//	disabled.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
-// All rights reserved.  See copyright.h for copyright notice and limitation 
+// All rights reserved.  See copyright.h for copyright notice and limitation
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "system.h"
 
 //----------------------------------------------------------------------
 // DiskRequestDone
-// 	Disk interrupt handler.  Need this to be a C routine, because 
+// 	Disk interrupt handler.  Need this to be a C routine, because
 //	C++ can't handle pointers to member functions.
 //----------------------------------------------------------------------
 
@@ -31,6 +47,44 @@ DiskRequestDone (int arg)
     disk->RequestDone();
 }
 
+//----------------------------------------------------------------------
+// DiskRequest::DiskRequest
+// 	Initialize a request to read a run of adjacent sectors into cache
+//	entries, or to write them from the entries.
+//
+//	"entries" -- the cache entries of the sectors, in order
+//	"count" -- the number of sectors
+//----------------------------------------------------------------------
+
+DiskRequest::DiskRequest(CacheEntry **entries, int count, bool writing,
+			 bool readAhead)
+{
+    ASSERT(count > 0 && count <= MaxTransferSectors);
+    sector = entries[0]->sector;
+    this->count = count;
+    for (int i = 0; i < count; i++) {
+	ASSERT(entries[i]->sector == sector + i);
+	this->entries[i] = entries[i];
+    }
+    buffer = new char[count * SectorSize];
+    if (writing)
+	for (int i = 0; i < count; i++)
+	    bcopy(entries[i]->data, &buffer[i * SectorSize], SectorSize);
+    this->writing = writing;
+    this->readAhead = readAhead;
+    queuedAt = stats->totalTicks;
+    finished = FALSE;
+    waiters = 0;
+    done = new Semaphore("disk request", 0);
+    next = NULL;
+}
+
+DiskRequest::~DiskRequest()
+{
+    delete [] buffer;
+    delete done;
+}
+
 //----------------------------------------------------------------------
 // SynchDisk::SynchDisk
 // 	Initialize the synchronous interface to the physical disk, in turn
@@ -38,18 +92,35 @@ DiskRequestDone (int arg)
 //
 //	"name" -- UNIX file name to be used as storage for the disk data
 //	   (usually, "DISK")
+//	"policy" -- the order in which to serve queued requests
+//	"mapped" -- map the UNIX file into memory (cf. disk.h)
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk(char* name)
+SynchDisk::SynchDisk(char* name, DiskPolicy policy, bool mapped)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
-    disk = new Disk(name, DiskRequestDone, (int) this);
+    disk = new Disk(name, DiskRequestDone, (int) this, mapped);
     for(int i = 0; i < NumSectors; i++)
     {
         rwLock[i] = new ReadWriteLock("filesys rwLock");
         visiter[i] = 0;
     }
+
+    this->policy = policy;
+    queue = active = NULL;
+    headTrack = 0;
+    sweepingUp = TRUE;
+    aheadCount = 0;
+
+    cache = new CacheEntry[CacheSectors];
+    for (int i = 0; i < CacheSectors; i++) {
+	cache[i].sector = -1;
+	cache[i].valid = FALSE;
+	cache[i].dirty = FALSE;
+	cache[i].pinned = FALSE;
+	cache[i].lastUse = 0;
+	cache[i].request = NULL;
+    }
+    useCount = 0;
 }
 
 //----------------------------------------------------------------------
@@ -61,8 +132,7 @@ SynchDisk::SynchDisk(char* name)
 SynchDisk::~SynchDisk()
 {
     delete disk;
-    delete lock;
-    delete semaphore;
+    delete [] cache;
     for(int i = 0; i < NumSectors; i++)
         delete rwLock[i];
 }
@@ -70,7 +140,9 @@ SynchDisk::~SynchDisk()
 //----------------------------------------------------------------------
 // SynchDisk::ReadSector
 // 	Read the contents of a disk sector into a buffer.  Return only
-//	after the data has been read.
+//	after the data has been read.  If the sector is in the cache,
+//	the disk is not used at all; if it is on its way in, wait for
+//	that request instead of making another.
 //
 //	"sectorNumber" -- the disk sector to read
 //	"data" -- the buffer to hold the contents of the disk sector
@@ -79,16 +151,35 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    CacheEntry *entry = FindCached(sectorNumber);
+
+    if (entry != NULL && entry->valid)
+	stats->numDiskCacheHits++;
+    else {
+	// whenever we have to wait, somebody else may change the cache
+	// meanwhile, so look again afterwards
+	while (entry == NULL || !entry->valid) {
+	    if (entry != NULL)
+		Join(entry->request);
+	    else if ((entry = Replace(sectorNumber, TRUE)) != NULL)
+		Wait(Submit(&entry, 1, FALSE, FALSE));
+	    entry = FindCached(sectorNumber);
+	}
+    }
+    entry->lastUse = ++useCount;
+    bcopy(entry->data, data, SectorSize);
+
+    (void) interrupt->SetLevel(oldLevel);
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::WriteSector
-// 	Write the contents of a buffer into a disk sector.  Return only
-//	after the data has been written.
+// 	Write the contents of a buffer into a disk sector.  The data only
+//	goes into the cache; it reaches the disk when the sector is
+//	replaced, or on Flush.  Other readers see the new contents right
+//	away.  In a journal transaction, the sector is also pinned, and
+//	handed to the journal.
 //
 //	"sectorNumber" -- the disk sector to be written
 //	"data" -- the new contents of the disk sector
@@ -97,22 +188,420 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    CacheEntry *entry = FindCached(sectorNumber);
+
+    // a read on its way in would overwrite our data; a write on its
+    // way out has its own copy of the data already
+    while (entry == NULL || !entry->valid) {
+	if (entry != NULL)
+	    Join(entry->request);
+	else if ((entry = Replace(sectorNumber, TRUE)) != NULL) {
+	    entry->valid = TRUE;		// about to be overwritten
+	    break;
+	}
+	entry = FindCached(sectorNumber);
+    }
+    bcopy(data, entry->data, SectorSize);
+    entry->dirty = TRUE;
+    entry->lastUse = ++useCount;
+    if (!entry->pinned && journal != NULL && journal->InTransaction()) {
+	entry->pinned = TRUE;
+	journal->Log(sectorNumber);
+    }
+
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadAhead
+// 	Ask for a sector to be brought into the cache, without waiting
+//	for it.  The request is dropped if the sector is cached already,
+//	if too many read-aheads are outstanding, or if it would mean
+//	writing a dirty sector first.
+//
+//	"sectorNumber" -- the disk sector to read
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadAhead(int sectorNumber)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    CacheEntry *entry;
+
+    if (FindCached(sectorNumber) == NULL && aheadCount < ReadAheadQueueSize
+	    && (entry = Replace(sectorNumber, FALSE)) != NULL) {
+	aheadCount++;
+	stats->numReadAheads++;
+	(void) Submit(&entry, 1, FALSE, TRUE);
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Flush
+// 	Write every dirty sector in the cache back to disk, and wait until
+//	it is there.  The dirty sectors are taken in order, so that each
+//	run of adjacent ones is written by a single request.  Finally make
+//	sure the UNIX file holding the disk has it all, too.  Pinned
+//	sectors are left alone.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Flush()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    DiskRequest *requests[CacheSectors];
+    bool found = TRUE;
+
+    while (found) {
+	int numRequests = 0;
+	found = FALSE;
+	for (;;) {
+	    // the lowest dirty sector not being written yet starts a run
+	    CacheEntry *first = NULL;
+	    for (int i = 0; i < CacheSectors; i++)
+		if (cache[i].dirty && !cache[i].pinned
+			&& cache[i].request == NULL
+			&& (first == NULL || cache[i].sector < first->sector))
+		    first = &cache[i];
+	    if (first == NULL)
+		break;
+	    requests[numRequests++] = WriteRun(first);
+	}
+	for (int i = 0; i < numRequests; i++)
+	    Wait(requests[i]);
+
+	// sectors that were being read or written meanwhile
+	for (int i = 0; i < CacheSectors && !found; i++)
+	    if ((cache[i].dirty && !cache[i].pinned)
+		    || (cache[i].request != NULL
+					&& cache[i].request->writing)) {
+		found = TRUE;
+		if (cache[i].request != NULL)
+		    Join(cache[i].request);
+	    }
+    }
+    disk->Flush();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Sync
+// 	Make sure a sector is on disk as it is in the cache: write it,
+//	together with the dirty sectors next to it, if it is dirty, and
+//	wait for any write of it that is going on.
+//
+//	"sectorNumber" -- the disk sector to write; it must not be pinned
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Sync(int sectorNumber)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    CacheEntry *entry;
+
+    while ((entry = FindCached(sectorNumber)) != NULL) {
+	ASSERT(!entry->pinned);
+	if (entry->request != NULL)
+	    Join(entry->request);
+	else if (entry->dirty)
+	    Wait(WriteRun(entry));
+	else
+	    break;
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Unpin
+// 	Let a sector pinned by a journal transaction be written again.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Unpin(int sectorNumber)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    CacheEntry *entry = FindCached(sectorNumber);
+
+    ASSERT(entry != NULL && entry->pinned);
+    entry->pinned = FALSE;
+    (void) interrupt->SetLevel(oldLevel);
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::RequestDone
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// 	Disk interrupt handler.  Wake up any threads waiting for the disk
+//	request to finish, and start the next one.
 //----------------------------------------------------------------------
 
 void
 SynchDisk::RequestDone()
-{ 
-    semaphore->V();
+{
+    DiskRequest *request = active;
+
+    active = NULL;
+    request->finished = TRUE;
+    for (int i = 0; i < request->count; i++) {
+	CacheEntry *entry = request->entries[i];
+	if (!request->writing) {
+	    bcopy(&request->buffer[i * SectorSize], entry->data, SectorSize);
+	    entry->valid = TRUE;
+	}
+	entry->request = NULL;
+    }
+    if (request->readAhead)
+	aheadCount--;
+    else {
+	stats->numDiskRequests++;
+	stats->diskLatency += stats->totalTicks - request->queuedAt;
+    }
+
+    if (request->waiters == 0)
+	delete request;
+    else
+	for (int i = 0; i < request->waiters; i++)
+	    request->done->V();
+
+    Dispatch();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::FindCached
+// 	Return the cache entry holding "sector", or NULL if there is
+//	none.  Called with interrupts disabled.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SynchDisk::FindCached(int sector)
+{
+    for (int i = 0; i < CacheSectors; i++)
+	if (cache[i].sector == sector)
+	    return &cache[i];
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Replace
+// 	Take the least recently used cache entry that is neither pinned
+//	nor being read or written, for "sector".  Its contents are not valid until the sector is read.
+//	If that entry is dirty, it has to be written first: if "mayWait",
+//	write it (with the dirty sectors next to it) and wait; either way
+//	return NULL, as the caller has to look at the cache again.
+//	Called with interrupts disabled.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SynchDisk::Replace(int sector, bool mayWait)
+{
+    CacheEntry *victim = NULL;
+
+    for (int i = 0; i < CacheSectors; i++)
+	if (cache[i].request == NULL && !cache[i].pinned
+		&& (victim == NULL || cache[i].lastUse < victim->lastUse))
+	    victim = &cache[i];
+    ASSERT(victim != NULL);		// every entry is busy
+
+    if (victim->dirty) {
+	if (mayWait)
+	    Wait(WriteRun(victim));
+	return NULL;
+    }
+    victim->sector = sector;
+    victim->valid = FALSE;
+    victim->lastUse = ++useCount;
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Submit
+// 	Queue a request for a run of sectors, and start it if the disk
+//	is free.  Unless it is a read-ahead, the caller must Wait for it.
+//	Called with interrupts disabled.
+//
+//	"entries" -- the cache entries of the sectors, in order
+//	"count" -- the number of sectors
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::Submit(CacheEntry **entries, int count, bool writing,
+		  bool readAhead)
+{
+    DiskRequest *request = new DiskRequest(entries, count, writing,
+								readAhead);
+    DiskRequest **last = &queue;
+
+    for (int i = 0; i < count; i++) {
+	ASSERT(entries[i]->request == NULL);
+	entries[i]->request = request;
+	if (writing)
+	    entries[i]->dirty = FALSE;	// the request has the data now
+    }
+    if (!readAhead)
+	request->waiters = 1;
+    while (*last != NULL)
+	last = &(*last)->next;
+    *last = request;
+    Dispatch();
+    return request;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteRun
+// 	Write a dirty cache entry, together with the dirty entries of the
+//	sectors before and after it, as one request.  Entries that are
+//	pinned, or already being read or written, end the run.  The caller must Wait
+//	for the request.  Called with interrupts disabled.
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::WriteRun(CacheEntry *entry)
+{
+    CacheEntry *run[MaxTransferSectors];
+    CacheEntry *e;
+    int first = entry->sector, count = 1;
+
+    ASSERT(entry->dirty && !entry->pinned && entry->request == NULL);
+    while (count < MaxTransferSectors && first > 0
+	    && (e = FindCached(first - 1)) != NULL
+	    && e->dirty && !e->pinned && e->request == NULL) {
+	first--;
+	count++;
+    }
+    while (first + count < NumSectors && count < MaxTransferSectors
+	    && (e = FindCached(first + count)) != NULL
+	    && e->dirty && !e->pinned && e->request == NULL)
+	count++;
+
+    for (int i = 0; i < count; i++)
+	run[i] = FindCached(first + i);
+    return Submit(run, count, TRUE, FALSE);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Join
+// 	Wait for a request that somebody else made.  A read-ahead that
+//	somebody waits for is no longer speculative, and is served like
+//	any other.  Called with interrupts disabled.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Join(DiskRequest *request)
+{
+    ASSERT(!request->finished);
+    if (request->readAhead) {
+	request->readAhead = FALSE;
+	aheadCount--;
+    }
+    request->waiters++;
+    Wait(request);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Wait
+// 	Wait for a request we are counted as a waiter of, then let go of
+//	it.  Called with interrupts disabled.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Wait(DiskRequest *request)
+{
+    request->done->P();
+    if (--request->waiters == 0)
+	delete request;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Pick
+// 	Choose which of the queued requests (read-aheads or the others)
+//	to serve next, according to the scheduling policy and the track
+//	the disk head is on.  Among equally good requests, the oldest is
+//	chosen.  Return NULL if there are none.
+//
+//	"readAhead" -- choose among the read-aheads?
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::Pick(bool readAhead)
+{
+    DiskRequest *best = NULL;
+    int bestTrack = 0;
+
+    for (DiskRequest *r = queue; r != NULL; r = r->next) {
+	if (r->readAhead != readAhead)
+	    continue;
+	int track = r->sector / SectorsPerTrack;
+	bool better;
+
+	if (best == NULL)
+	    better = TRUE;
+	else switch (policy) {
+	  case DiskFCFS:
+	    better = FALSE;
+	    break;
+	  case DiskSSTF:
+	    better = abs(track - headTrack) < abs(bestTrack - headTrack);
+	    break;
+	  case DiskSCAN:
+	  case DiskCLOOK:
+	    {
+		// ahead of the head in the sweep direction comes first,
+		// nearest first; behind it, C-LOOK starts again from the
+		// far end, and SCAN turns around
+		int dir = (policy == DiskCLOOK || sweepingUp) ? 1 : -1;
+		int dist = (track - headTrack) * dir;
+		int bestDist = (bestTrack - headTrack) * dir;
+		if ((dist >= 0) != (bestDist >= 0))
+		    better = (dist >= 0);
+		else if (dist >= 0 || policy == DiskSCAN)
+		    better = abs(dist) < abs(bestDist);
+		else
+		    better = dist < bestDist;
+	    }
+	    break;
+	}
+	if (better) {
+	    best = r;
+	    bestTrack = track;
+	}
+    }
+    return best;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Dispatch
+// 	If the disk is free, take the next request off the queue and
+//	start it.  Read-aheads only get the disk if nothing else is
+//	waiting for it.  Called with interrupts disabled.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Dispatch()
+{
+    if (active != NULL || queue == NULL)
+	return;
+
+    DiskRequest *request = Pick(FALSE);
+    if (request == NULL)
+	request = Pick(TRUE);
+
+    DiskRequest **link = &queue;
+    while (*link != request)
+	link = &(*link)->next;
+    *link = request->next;
+    request->next = NULL;
+
+    int track = request->sector / SectorsPerTrack;
+    if (track != headTrack)
+	sweepingUp = (track > headTrack);
+    stats->diskSeekDistance += abs(track - headTrack);
+    headTrack = track;
+
+    active = request;
+    if (request->writing)
+	disk->WriteRequest(request->sector, request->buffer, request->count);
+    else
+	disk->ReadRequest(request->sector, request->buffer, request->count);
 }
 
 void
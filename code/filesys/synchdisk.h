@@ -1,9 +1,9 @@
-// synchdisk.h 
-// 	Data structures to export a synchronous interface to the raw 
+// synchdisk.h
+// 	Data structures to export a synchronous interface to the raw
 //	disk device.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
-// All rights reserved.  See copyright.h for copyright notice and limitation 
+// All rights reserved.  See copyright.h for copyright notice and limitation
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
@@ -14,6 +14,66 @@
 #include "disk.h"
 #include "synch.h"
 
+#define CacheSectors		128	// sectors kept in the buffer cache;
+					// more than the journal can pin
+#define ReadAheadQueueSize	32	// read-ahead requests waiting for
+					// the disk
+#define MaxTransferSectors	SectorsPerTrack
+					// most sectors in one disk request
+
+// The order in which queued requests are sent to the disk.
+enum DiskPolicy { DiskFCFS,		// first come, first served
+		  DiskSSTF,		// shortest seek first
+		  DiskSCAN,		// elevator, sweeping both ways
+		  DiskCLOOK		// elevator, sweeping one way only
+};
+
+class DiskRequest;
+
+// A sector kept in the buffer cache.
+
+class CacheEntry {
+  public:
+    int sector;				// Sector cached here, -1 if none
+    bool valid;				// FALSE until the sector is read in
+    bool dirty;				// Changed since it was last written?
+    bool pinned;			// Written by a journal transaction
+					// not committed yet, so it may not
+					// be written to disk
+    int lastUse;			// When it was last used, for LRU
+    DiskRequest *request;		// Request reading or writing this
+					// entry, NULL if none; an entry
+					// with a request is never replaced
+    char data[SectorSize];		// Contents of the sector
+};
+
+// A request waiting for, or using, the disk.  It covers a run of
+// adjacent sectors, each of which goes to or from a cache entry; the
+// data of a write is copied out when the request is made.  Any number
+// of threads may wait for a request to finish; the last one to stop
+// waiting deletes it.
+
+class DiskRequest {
+  public:
+    DiskRequest(CacheEntry **entries, int count, bool writing,
+		bool readAhead);
+    ~DiskRequest();
+
+    int sector;				// First sector of the run
+    int count;				// Number of sectors
+    CacheEntry *entries[MaxTransferSectors];
+					// Entry of each sector
+    char *buffer;			// Data of the whole run
+    bool writing;			// Write, rather than read?
+    bool readAhead;			// Nobody is waiting for it yet, so
+					// it is served after the others
+    int queuedAt;			// When the request was made
+    bool finished;			// Has the disk completed it?
+    int waiters;			// Threads waiting for it to finish
+    Semaphore *done;			// Signalled once per waiter
+    DiskRequest *next;			// Next request in the queue
+};
+
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
 // requests to read or write portions of the disk return immediately,
@@ -24,20 +84,43 @@
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
 // returning.
+//
+// Requests from all threads go into a queue, and whenever the disk
+// becomes free the next one is picked according to the scheduling
+// policy, so several threads can have requests outstanding at once.
+// Recently used sectors are kept in a write-back buffer cache: writes
+// only go to the disk when a dirty sector is replaced, or on Flush or
+// Sync, and then adjacent dirty sectors are written with a single
+// request.  The journal pins the sectors of a transaction in the cache
+// until the transaction is committed.
+// Callers may also ask for sectors to be read ahead into the cache;
+// nobody waits for those reads, and they only get the disk when it
+// would otherwise be idle.
 class SynchDisk {
   public:
-    SynchDisk(char* name);    		// Initialize a synchronous disk,
+    SynchDisk(char* name, DiskPolicy policy = DiskCLOOK,
+	      bool mapped = FALSE);
+    					// Initialize a synchronous disk,
 					// by initializing the raw Disk.
     ~SynchDisk();			// De-allocate the synch disk data
-    
+
     void ReadSector(int sectorNumber, char* data);
-    					// Read/write a disk sector, returning
-    					// only once the data is actually read 
-					// or written.  These call
-    					// Disk::ReadRequest/WriteRequest and
-					// then wait until the request is done.
+    					// Read/write a disk sector, through
+    					// the cache.  A read that misses
+					// queues a request for the disk and
+    					// waits until it is done; a write
+					// waits only to make room for it.
     void WriteSector(int sectorNumber, char* data);
-    
+
+    void ReadAhead(int sectorNumber);	// Bring a sector into the cache in
+					// the background, if it isn't there
+    void Flush();			// Write every dirty sector to disk,
+					// and the disk to the UNIX file
+    void Sync(int sectorNumber);	// Write one sector to disk now, and
+					// wait until it is there
+    void Unpin(int sectorNumber);	// Let a sector pinned by the journal
+					// be written
+
     void RequestDone();			// Called by the disk device interrupt
 					// handler, to signal that the
 					// current disk operation is complete.
@@ -50,10 +133,32 @@ class SynchDisk {
     int visiter[NumSectors];
   private:
     Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    DiskPolicy policy;			// How the next request is picked
+    DiskRequest *queue;			// Requests waiting for the disk,
+					// in the order they were made
+    DiskRequest *active;		// Request on the disk, NULL if idle
+    int headTrack;			// Track of the last request sent
+    bool sweepingUp;			// Direction of the SCAN sweep
+    int aheadCount;			// Read-aheads not finished yet
+
+    CacheEntry *cache;			// The buffer cache
+    int useCount;			// Clock for the LRU replacement
+
+    CacheEntry *FindCached(int sector);	// Cache entry for sector, or NULL
+    CacheEntry *Replace(int sector, bool mayWait);
+					// Reuse the least recently used
+					// entry for sector
+    DiskRequest *Submit(CacheEntry **entries, int count, bool writing,
+			bool readAhead);
+					// Queue a request for the disk
+    DiskRequest *WriteRun(CacheEntry *entry);
+					// Write the dirty sectors around
+					// entry with one request
+    void Join(DiskRequest *request);	// Wait for someone else's request
+    void Wait(DiskRequest *request);	// Wait for our own request
+    DiskRequest *Pick(bool readAhead);	// Next request, by policy
+    void Dispatch();			// Start the next request, if the
+					// disk is free
 
     ReadWriteLock* rwLock[NumSectors];
 };
@@ -38,9 +38,12 @@ static void DiskDone(int arg) { ((Disk *)arg)->HandleInterrupt(); }
 //	"callWhenDone" -- interrupt handler to be called when disk read/write
 //	   request completes
 //	"callArg" -- argument to pass the interrupt handler
+//	"mapped" -- access the file through a memory mapping, rather than
+//	   with read and write system calls
 //----------------------------------------------------------------------
 
-Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
+Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg,
+	   bool mapped)
 {
     int magicNum;
     int tmp = 0;
@@ -64,6 +67,9 @@ Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
         Lseek(fileno, DiskSize - sizeof(int), 0);	
 	WriteFile(fileno, (char *)&tmp, sizeof(int));  
     }
+    image = NULL;
+    if (mapped)				// the whole file, magic number too
+	image = MapFile(fileno, DiskSize);
     active = FALSE;
 }
 
@@ -75,9 +81,27 @@ Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
 
 Disk::~Disk()
 {
+    if (image != NULL) {
+	SyncMappedFile(image, DiskSize);
+	UnmapFile(image, DiskSize);
+    }
     Close(fileno);
 }
 
+//----------------------------------------------------------------------
+// Disk::Flush()
+// 	Make sure the UNIX file has the data of every request so far.
+//	Without a mapping, each request was a system call of its own, so
+//	there is nothing to do.
+//----------------------------------------------------------------------
+
+void
+Disk::Flush()
+{
+    if (image != NULL)
+	SyncMappedFile(image, DiskSize);
+}
+
 //----------------------------------------------------------------------
 // Disk::PrintSector()
 // 	Dump the data in a disk read/write request, for debugging.
@@ -99,7 +123,7 @@ PrintSector (bool writing, int sector, char *data)
 
 //----------------------------------------------------------------------
 // Disk::ReadRequest/WriteRequest
-// 	Simulate a request to read/write a single disk sector
+// 	Simulate a request to read/write a run of disk sectors
 //	   Do the read/write immediately to the UNIX file
 //	   Set up an interrupt handler to be called later,
 //	      that will notify the caller when the simulator says
@@ -108,46 +132,61 @@ PrintSector (bool writing, int sector, char *data)
 //	Note that a disk only allows an entire sector to be read/written,
 //	not part of a sector.
 //
-//	"sectorNumber" -- the disk sector to read/write
+//	"sectorNumber" -- the first disk sector to read/write
 //	"data" -- the bytes to be written, the buffer to hold the incoming bytes
+//	"count" -- the number of adjacent sectors to transfer
 //----------------------------------------------------------------------
 
 void
-Disk::ReadRequest(int sectorNumber, char* data)
+Disk::ReadRequest(int sectorNumber, char* data, int count)
 {
-    int ticks = ComputeLatency(sectorNumber, FALSE);
+    int ticks = ComputeLatency(sectorNumber, count, FALSE);
 
     ASSERT(!active);				// only one request at a time
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((sectorNumber >= 0) && (count > 0)
+				&& (sectorNumber + count <= NumSectors));
     
-    DEBUG('d', "Reading from sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
+    DEBUG('d', "Reading from sector %d, %d sectors\n", sectorNumber, count);
+    if (image != NULL)
+	bcopy(&image[SectorSize * sectorNumber + MagicSize], data,
+							SectorSize * count);
+    else {
+	Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
+	Read(fileno, data, SectorSize * count);
+    }
     if (DebugIsEnabled('d'))
-	PrintSector(FALSE, sectorNumber, data);
+	for (int i = 0; i < count; i++)
+	    PrintSector(FALSE, sectorNumber + i, &data[i * SectorSize]);
     
     active = TRUE;
-    UpdateLast(sectorNumber);
+    UpdateLast(sectorNumber, count);
     stats->numDiskReads++;
     interrupt->Schedule(DiskDone, (int) this, ticks, DiskInt);
 }
 
 void
-Disk::WriteRequest(int sectorNumber, char* data)
+Disk::WriteRequest(int sectorNumber, char* data, int count)
 {
-    int ticks = ComputeLatency(sectorNumber, TRUE);
+    int ticks = ComputeLatency(sectorNumber, count, TRUE);
 
     ASSERT(!active);
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((sectorNumber >= 0) && (count > 0)
+				&& (sectorNumber + count <= NumSectors));
     
-    DEBUG('d', "Writing to sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
+    DEBUG('d', "Writing to sector %d, %d sectors\n", sectorNumber, count);
+    if (image != NULL)
+	bcopy(data, &image[SectorSize * sectorNumber + MagicSize],
+							SectorSize * count);
+    else {
+	Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
+	WriteFile(fileno, data, SectorSize * count);
+    }
     if (DebugIsEnabled('d'))
-	PrintSector(TRUE, sectorNumber, data);
+	for (int i = 0; i < count; i++)
+	    PrintSector(TRUE, sectorNumber + i, &data[i * SectorSize]);
     
     active = TRUE;
-    UpdateLast(sectorNumber);
+    UpdateLast(sectorNumber, count);
     stats->numDiskWrites++;
     interrupt->Schedule(DiskDone, (int) this, ticks, DiskInt);
 }
@@ -252,20 +291,44 @@ Disk::ComputeLatency(int newSector, bool writing)
     return(seek + rotation + RotationTime);
 }
 
+//----------------------------------------------------------------------
+// Disk::ComputeLatency()
+// 	Return how long it will take to read/write a run of "count"
+//	adjacent sectors starting at newSector: the latency of the first
+//	one, then one rotation per further sector, and a single track seek
+//	wherever the run crosses into the next track.
+//----------------------------------------------------------------------
+
+int
+Disk::ComputeLatency(int newSector, int count, bool writing)
+{
+    int endSector = newSector + count - 1;
+    int crossings = endSector / SectorsPerTrack - newSector / SectorsPerTrack;
+
+    return ComputeLatency(newSector, writing) + (count - 1) * RotationTime
+						+ crossings * SeekTime;
+}
+
 //----------------------------------------------------------------------
 // Disk::UpdateLast
 //   	Keep track of the most recently requested sector.  So we can know
-//	what is in the track buffer.
+//	what is in the track buffer.  A run that ends on another track
+//	than it started on leaves the head on that track, whose buffer
+//	started loading when the head arrived there.
 //----------------------------------------------------------------------
 
 void
-Disk::UpdateLast(int newSector)
+Disk::UpdateLast(int newSector, int count)
 {
     int rotate;
     int seek = TimeToSeek(newSector, &rotate);
+    int endSector = newSector + count - 1;
     
     if (seek != 0)
 	bufferInit = stats->totalTicks + seek + rotate;
-    lastSector = newSector;
+    if (endSector / SectorsPerTrack != newSector / SectorsPerTrack)
+	bufferInit = stats->totalTicks + ComputeLatency(newSector, count, FALSE)
+		- ((endSector % SectorsPerTrack) + 1) * RotationTime;
+    lastSector = endSector;
     DEBUG('d', "Updating last sector = %d, %d\n", lastSector, bufferInit);
 }
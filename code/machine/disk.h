@@ -45,6 +45,18 @@
 // disks these days now come with a track buffer.
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+//
+// The UNIX file may also be mapped into memory, so that a request is
+// a memory copy rather than a seek plus a read or write system call.
+// This only makes the simulation run faster; the simulated time of
+// each request is the same either way.  Changes reach the UNIX file
+// when the disk is flushed or deleted.
+//
+// A request may also cover a run of adjacent sectors.  It pays for
+// positioning the head once; after that each sector only costs the
+// time to rotate past it, plus a seek for each track boundary crossed
+// (tracks are assumed to be skewed so that the run continues right
+// after the seek).
 
 #define SectorSize 		128	// number of bytes per disk sector
 #define SectorsPerTrack 	32	// number of sectors per disk track 
@@ -54,29 +66,40 @@
 
 class Disk {
   public:
-    Disk(char* name, VoidFunctionPtr callWhenDone, int callArg);
+    Disk(char* name, VoidFunctionPtr callWhenDone, int callArg,
+	 bool mapped = FALSE);
     					// Create a simulated disk.  
 					// Invoke (*callWhenDone)(callArg) 
 					// every time a request completes.
+					// If "mapped", map the UNIX file
+					// into memory.
     ~Disk();				// Deallocate the disk.
     
-    void ReadRequest(int sectorNumber, char* data);
-    					// Read/write an single disk sector.
+    void ReadRequest(int sectorNumber, char* data, int count = 1);
+    					// Read/write "count" disk sectors,
+					// starting at sectorNumber.
 					// These routines send a request to 
     					// the disk and return immediately.
     					// Only one request allowed at a time!
-    void WriteRequest(int sectorNumber, char* data);
+    void WriteRequest(int sectorNumber, char* data, int count = 1);
 
     void HandleInterrupt();		// Interrupt handler, invoked when
 					// disk request finishes.
 
+    void Flush();			// Make sure everything written is
+					// in the UNIX file
+
     int ComputeLatency(int newSector, bool writing);	
     					// Return how long a request to 
 					// newSector will take: 
 					// (seek + rotational delay + transfer)
+    int ComputeLatency(int newSector, int count, bool writing);
+					// Same, for a run of "count" sectors
 
   private:
     int fileno;				// UNIX file number for simulated disk 
+    char *image;			// The UNIX file mapped into memory,
+					// NULL if it is not mapped
     VoidFunctionPtr handler;		// Interrupt handler, to be invoked 
 					// when any disk request finishes
     int handlerArg;			// Argument to interrupt handler 
@@ -87,7 +110,7 @@ class Disk {
 
     int TimeToSeek(int newSector, int *rotate); // time to get to the new track
     int ModuloDiff(int to, int from);        // # sectors between to and from
-    void UpdateLast(int newSector);
+    void UpdateLast(int newSector, int count = 1);
 };
 
 #endif // DISK_H
@@ -14,6 +14,13 @@
 //		a user instruction is executed
 //		there is nothing in the ready queue
 //
+//	Pending interrupts are kept in a heap ordered by when they are
+//	due, so scheduling one, or taking out the next one, is done in
+//	logarithmic time, and checking whether anything is due yet, on
+//	every tick, in constant time.  The PendingInterrupt objects are
+//	reused, so that once the heap has grown to its working size
+//	nothing more is allocated.
+//
 //  DO NOT CHANGE -- part of the machine emulation
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -28,7 +35,8 @@
 
 static char *intLevelNames[] = { "off", "on"};
 static char *intTypeNames[] = { "timer", "disk", "console write", 
-			"console read", "network send", "network recv"};
+			"console read", "elevator", "network send",
+			"network recv", "alarm"};
 
 //----------------------------------------------------------------------
 // PendingInterrupt::PendingInterrupt
@@ -60,7 +68,11 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new List();
+    maxPending = 16;
+    pending = new PendingInterrupt *[maxPending];
+    numPending = 0;
+    nextSeq = 0;
+    unused = NULL;
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
@@ -73,9 +85,14 @@ Interrupt::Interrupt()
 
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty())
-	delete (PendingInterrupt *)pending->Remove();
-    delete pending;
+    for (int i = 0; i < numPending; i++)
+	delete pending[i];
+    delete [] pending;
+    while (unused != NULL) {
+	PendingInterrupt *next = unused->next;
+	delete unused;
+	unused = next;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -203,6 +220,8 @@ Interrupt::YieldOnReturn()
 //	Since something has to be running in order to put a thread
 //	on the ready queue, the only thing to do is to advance 
 //	simulated time until the next scheduled hardware interrupt.
+//	(The scheduler's time slice timer is only set while threads
+//	are waiting for the CPU, so it never wakes us up for nothing.)
 //
 //	If there are no pending interrupts, stop.  There's nothing
 //	more for us to do.
@@ -230,16 +249,24 @@ Interrupt::Idle()
     DEBUG('i', "Machine idle.  No interrupts to do.\n");
     printf("No threads ready or runnable, and no pending interrupts.\n");
     printf("Assuming the program completed.\n");
+    if (ForkHalt()) {			// halt from a thread, once the file
+        status = SystemMode;		// system is written back
+        return;
+    }
     Halt();
 }
 
 //----------------------------------------------------------------------
 // Interrupt::Halt
 // 	Shut down Nachos cleanly, printing out performance statistics.
+//	Unless we are idle, we are running in a thread, which can wait
+//	for the file system to be written back first.
 //----------------------------------------------------------------------
 void
 Interrupt::Halt()
 {
+    if (status != IdleMode)
+	SyncFileSystem();
     printf("Machine halting!\n\n");
     stats->Print();
     Cleanup();     // Never returns.
@@ -250,7 +277,7 @@ Interrupt::Halt()
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: put it in the heap of pending interrupts.
 //
 //	NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.
@@ -260,18 +287,71 @@ Interrupt::Halt()
 //	"fromNow" is how far in the future (in simulated time) the 
 //		 interrupt is to occur
 //	"type" is the hardware device that generated the interrupt
+//
+//	Returns the pending interrupt, which may be passed to Cancel
+//	until the handler has been called.
 //----------------------------------------------------------------------
-void
+PendingInterrupt *
 Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 {
     int when = stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(handler, arg, when, type);
+    PendingInterrupt *toOccur;
 
     DEBUG('i', "Scheduling interrupt handler the %s at time = %d\n", 
 					intTypeNames[type], when);
     ASSERT(fromNow > 0);
 
-    pending->SortedInsert(toOccur, when);
+    if (unused != NULL) {
+	toOccur = unused;
+	unused = unused->next;
+	toOccur->handler = handler;
+	toOccur->arg = arg;
+	toOccur->when = when;
+	toOccur->type = type;
+    } else
+	toOccur = new PendingInterrupt(handler, arg, when, type);
+    toOccur->seq = nextSeq++;
+
+    if (numPending == maxPending) {
+	PendingInterrupt **bigger = new PendingInterrupt *[2 * maxPending];
+	for (int i = 0; i < numPending; i++)
+	    bigger[i] = pending[i];
+	delete [] pending;
+	pending = bigger;
+	maxPending *= 2;
+    }
+    toOccur->heapIndex = numPending;
+    pending[numPending++] = toOccur;
+    SiftUp(toOccur->heapIndex);
+    return toOccur;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Cancel
+// 	Remove an interrupt that was scheduled, but has not occurred,
+//	so that its handler is never called.
+//
+//	"toCancel" is what Schedule returned for the interrupt
+//----------------------------------------------------------------------
+void
+Interrupt::Cancel(PendingInterrupt *toCancel)
+{
+    DEBUG('i', "Cancelling interrupt handler the %s at time = %d\n", 
+				intTypeNames[toCancel->type], toCancel->when);
+    RemovePending(toCancel);
+    toCancel->next = unused;		// keep it for reuse
+    unused = toCancel;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::NextDue
+// 	Return when the next pending interrupt is due, or -1 if there
+//	is none.
+//----------------------------------------------------------------------
+int
+Interrupt::NextDue()
+{
+    return numPending == 0 ? -1 : pending[0]->when;
 }
 
 //----------------------------------------------------------------------
@@ -297,26 +377,23 @@ Interrupt::CheckIfDue(bool advanceClock)
 					// to invoke an interrupt handler
     if (DebugIsEnabled('i'))
 	DumpState();
-    PendingInterrupt *toOccur = 
-		(PendingInterrupt *)pending->SortedRemove(&when);
-
-    if (toOccur == NULL)		// no pending interrupts
+    if (numPending == 0)		// no pending interrupts
 	return FALSE;			
+    PendingInterrupt *toOccur = pending[0];
+    when = toOccur->when;
 
     if (advanceClock && when > stats->totalTicks) {	// advance the clock
 	stats->idleTicks += (when - stats->totalTicks);
 	stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {	// not time yet, put it back
-	pending->SortedInsert(toOccur, when);
+    } else if (when > stats->totalTicks)	// not time yet
 	return FALSE;
-    }
 
 // Check if there is nothing more to do, and if so, quit
     if ((status == IdleMode) && (toOccur->type == TimerInt) 
-				&& pending->IsEmpty()) {
-	 pending->SortedInsert(toOccur, when);
+				&& numPending == 1)
 	 return FALSE;
-    }
+
+    RemovePending(toOccur);		// before the handler schedules more
 
     DEBUG('i', "Invoking interrupt handler for the %s at time %d\n", 
 			intTypeNames[toOccur->type], toOccur->when);
@@ -331,10 +408,89 @@ Interrupt::CheckIfDue(bool advanceClock)
     (*(toOccur->handler))(toOccur->arg);	// call the interrupt handler
     status = old;				// restore the machine status
     inHandler = FALSE;
-    delete toOccur;
+    toOccur->next = unused;			// keep it for reuse
+    unused = toOccur;
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Interrupt::Earlier
+// 	Return TRUE if interrupt "a" should occur before interrupt "b":
+//	it is due earlier, or at the same time but was scheduled first.
+//----------------------------------------------------------------------
+bool
+Interrupt::Earlier(PendingInterrupt *a, PendingInterrupt *b)
+{
+    if (a->when != b->when)
+	return a->when < b->when;
+    return a->seq < b->seq;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::SiftUp
+// Interrupt::SiftDown
+// 	Move pending[i] towards the top of the heap while it is earlier
+//	than its parent, or towards the bottom while one of its children
+//	is earlier than it, keeping each interrupt's heapIndex up to date.
+//----------------------------------------------------------------------
+void
+Interrupt::SiftUp(int i)
+{
+    PendingInterrupt *moving = pending[i];
+
+    while (i > 0 && Earlier(moving, pending[(i - 1) / 2])) {
+	pending[i] = pending[(i - 1) / 2];
+	pending[i]->heapIndex = i;
+	i = (i - 1) / 2;
+    }
+    pending[i] = moving;
+    moving->heapIndex = i;
+}
+
+void
+Interrupt::SiftDown(int i)
+{
+    PendingInterrupt *moving = pending[i];
+
+    for (;;) {
+	int child = 2 * i + 1;
+	if (child >= numPending)
+	    break;
+	if (child + 1 < numPending && Earlier(pending[child + 1], pending[child]))
+	    child++;
+	if (!Earlier(pending[child], moving))
+	    break;
+	pending[i] = pending[child];
+	pending[i]->heapIndex = i;
+	i = child;
+    }
+    pending[i] = moving;
+    moving->heapIndex = i;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::RemovePending
+// 	Take an interrupt out of the heap, wherever it is, by moving the
+//	last interrupt into its place.
+//
+//	"toRemove" is the interrupt to take out
+//----------------------------------------------------------------------
+void
+Interrupt::RemovePending(PendingInterrupt *toRemove)
+{
+    int i = toRemove->heapIndex;
+
+    ASSERT(i >= 0 && i < numPending && pending[i] == toRemove);
+    numPending--;
+    if (i < numPending) {
+	PendingInterrupt *moved = pending[numPending];
+	pending[i] = moved;
+	SiftUp(i);
+	SiftDown(moved->heapIndex);
+    }
+    toRemove->heapIndex = -1;
+}
+
 //----------------------------------------------------------------------
 // PrintPending
 // 	Print information about an interrupt that is scheduled to occur.
@@ -363,7 +519,8 @@ Interrupt::DumpState()
 					intLevelNames[level]);
     printf("Pending interrupts:\n");
     fflush(stdout);
-    pending->Mapcar(PrintPending);
+    for (int i = 0; i < numPending; i++)	// in heap order, not sorted
+	PrintPending((int)pending[i]);
     printf("End of pending interrupts\n");
     fflush(stdout);
 }
@@ -48,9 +48,12 @@ enum MachineStatus {IdleMode, SystemMode, UserMode};
 
 // IntType records which hardware device generated an interrupt.
 // In Nachos, we support a hardware timer device, a disk, a console
-// display and keyboard, and a network.
+// display and keyboard, and a network.  AlarmInt is the timer too,
+// waking up sleeping threads; unlike TimerInt, it keeps an otherwise
+// idle machine running until they are awake.
 enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt, 
-				ElevatorInt, NetworkSendInt, NetworkRecvInt};
+				ElevatorInt, NetworkSendInt, NetworkRecvInt,
+				AlarmInt};
 
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
@@ -67,6 +70,12 @@ class PendingInterrupt {
     int arg;                    // The argument to the function.
     int when;			// When the interrupt is supposed to fire
     IntType type;		// for debugging
+    int seq;			// Order of scheduling, so interrupts due
+				// at the same time occur first come,
+				// first served
+    int heapIndex;		// Where it is in the pending heap
+    PendingInterrupt *next;	// Next unused interrupt, while this one
+				// is unused too
 };
 
 // The following class defines the data structures for the simulation
@@ -106,16 +115,30 @@ class Interrupt {
     // but they need to be public since they are called by the
     // hardware device simulators.
 
-    void Schedule(VoidFunctionPtr handler,// Schedule an interrupt to occur
-	int arg, int when, IntType type);// at time ``when''.  This is called
+    PendingInterrupt *Schedule(VoidFunctionPtr handler,
+	int arg, int when, IntType type);// Schedule an interrupt to occur
+					// at time ``when''.  This is called
     					// by the hardware device simulators.
+    void Cancel(PendingInterrupt *toCancel);
+					// Take back an interrupt that has
+					// not occurred yet
     
     void OneTick();       		// Advance simulated time
 
+    int NextDue();			// When the next interrupt is due,
+					// -1 if none is pending
+
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    List *pending;		// the list of interrupts scheduled
-				// to occur in the future
+    PendingInterrupt **pending;	// the interrupts scheduled to occur
+				// in the future, as a heap: the earliest
+				// is pending[0], and the children of
+				// pending[i] are pending[2i+1], [2i+2]
+    int numPending;		// interrupts in the heap
+    int maxPending;		// room in the heap, before it grows
+    int nextSeq;		// "seq" of the next interrupt scheduled
+    PendingInterrupt *unused;	// interrupts that have occurred or been
+				// cancelled, to be used again
     bool inHandler;		// TRUE if we are running an interrupt handler
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
@@ -126,6 +149,13 @@ class Interrupt {
     bool CheckIfDue(bool advanceClock); // Check if an interrupt is supposed
 					// to occur now
 
+    bool Earlier(PendingInterrupt *a, PendingInterrupt *b);
+					// Should "a" occur before "b"?
+    void SiftUp(int i);			// Restore the heap order above and
+    void SiftDown(int i);		// below pending[i]
+    void RemovePending(PendingInterrupt *toRemove);
+					// Take an interrupt out of the heap
+
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 	IntStatus now);  		// simulated time
 };
@@ -20,6 +20,10 @@ Statistics::Statistics()
 {
     totalTicks = idleTicks = systemTicks = userTicks = 0;
     numDiskReads = numDiskWrites = 0;
+    numDiskCacheHits = numReadAheads = 0;
+    numDiskRequests = diskLatency = diskSeekDistance = 0;
+    numJournalCommits = numJournalSectors = 0;
+    numThreadsFinished = threadResponseTicks = threadWaitTicks = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
 }
@@ -36,6 +40,17 @@ Statistics::Print()
     printf("Ticks: total %d, idle %d, system %d, user %d\n", totalTicks, 
 	idleTicks, systemTicks, userTicks);
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
+    printf("Disk cache: hits %d, read ahead %d\n", numDiskCacheHits,
+	numReadAheads);
+    printf("Disk scheduling: seek distance %d tracks, average latency %d\n",
+	diskSeekDistance,
+	numDiskRequests == 0 ? 0 : diskLatency / numDiskRequests);
+    printf("Journal: commits %d, sectors %d\n", numJournalCommits,
+	numJournalSectors);
+    printf("Threads: finished %d, average response %d, average wait %d\n",
+	numThreadsFinished,
+	numThreadsFinished == 0 ? 0 : threadResponseTicks / numThreadsFinished,
+	numThreadsFinished == 0 ? 0 : threadWaitTicks / numThreadsFinished);
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
     printf("Paging: faults %d\n", numPageFaults);
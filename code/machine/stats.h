@@ -30,6 +30,18 @@ class Statistics {
 
     int numDiskReads;		// number of disk read requests
     int numDiskWrites;		// number of disk write requests
+    int numDiskCacheHits;	// number of sector reads found in the cache
+    int numReadAheads;		// number of sectors read ahead
+    int numDiskRequests;	// number of disk requests threads waited for
+    int diskLatency;		// total ticks from making those requests
+				// until they were done
+    int diskSeekDistance;	// total number of tracks the head moved
+    int numJournalCommits;	// number of groups written to the journal
+    int numJournalSectors;	// number of sectors in those groups
+    int numThreadsFinished;	// number of threads that have finished
+    int threadResponseTicks;	// total ticks from creating those threads
+				// until they first ran
+    int threadWaitTicks;	// total ticks they spent ready, not running
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
@@ -265,6 +265,48 @@ Unlink(char *name)
     return unlink(name);
 }
 
+//----------------------------------------------------------------------
+// MapFile
+// 	Map the first "nBytes" of an open file into memory, shared, so
+//	that stores into the mapping change the file.  Abort on error.
+//----------------------------------------------------------------------
+
+char *
+MapFile(int fd, int nBytes)
+{
+    void *addr = mmap(NULL, nBytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+								fd, 0);
+
+    ASSERT(addr != MAP_FAILED);
+    return (char *) addr;
+}
+
+//----------------------------------------------------------------------
+// SyncMappedFile
+// 	Write the changes made through a mapping back to the file, and
+//	wait until they are there.
+//----------------------------------------------------------------------
+
+void
+SyncMappedFile(char *addr, int nBytes)
+{
+    int retVal = msync(addr, nBytes, MS_SYNC);
+    ASSERT(retVal >= 0);
+}
+
+//----------------------------------------------------------------------
+// UnmapFile
+// 	Undo a MapFile.  Changes not synced yet still reach the file
+//	eventually.
+//----------------------------------------------------------------------
+
+void
+UnmapFile(char *addr, int nBytes)
+{
+    int retVal = munmap(addr, nBytes);
+    ASSERT(retVal >= 0);
+}
+
 //----------------------------------------------------------------------
 // OpenSocket
 // 	Open an interprocess communication (IPC) connection.  For now, 
@@ -29,6 +29,12 @@ extern int Tell(int fd);
 extern void Close(int fd);
 extern bool Unlink(char *name);
 
+// Map an open file into memory, so that it can be accessed without
+// a system call per operation; sync changes back to the file, and unmap
+extern char *MapFile(int fd, int nBytes);
+extern void SyncMappedFile(char *addr, int nBytes);
+extern void UnmapFile(char *addr, int nBytes);
+
 // Interprocess communication operations, for simulating the network
 extern int OpenSocket();
 extern void CloseSocket(int sockID);
@@ -18,6 +18,27 @@ void append(char* path, char* src)
     path[i] = '\0';
 }
 
+/* run "left | right": left's output goes to right's input through
+ * a pipe, with no disk involved */
+void pipeline(char* left, char* right)
+{
+    OpenFileId fds[2];
+    SpaceId leftProc, rightProc;
+
+    if(Pipe(fds) < 0)
+        return;
+    leftProc = ExecIO(left, ConsoleInput, fds[1]);
+    rightProc = ExecIO(right, fds[0], ConsoleOutput);
+    /* only the children may hold the ends now, so that the reader
+     * sees end of file when the writer exits */
+    Close(fds[0]);
+    Close(fds[1]);
+    if(leftProc != -1)
+        Join(leftProc);
+    if(rightProc != -1)
+        Join(rightProc);
+}
+
 int
 main()
 {
@@ -29,6 +50,7 @@ main()
     char* src;
     char* dst;
     int strlen;
+    char* bar;
 
 
     prompt[0] = '$';
@@ -52,7 +74,17 @@ main()
 
 	    buffer[--i] = '\0';
 
-        if(cmp(buffer,"ls", 2) == 1)
+        for(bar = buffer; *bar != '\0' && *bar != '|'; bar++);
+
+        if(*bar == '|')
+        {
+            for(dst = bar - 1; dst >= buffer && *dst == ' '; dst--)
+                *dst = '\0';
+            *bar = '\0';
+            for(bar++; *bar == ' '; bar++);
+            pipeline(buffer, bar);
+        }
+        else if(cmp(buffer,"ls", 2) == 1)
         {
             Ls();
         }
@@ -218,6 +218,62 @@ msgrcv:
 	j	$31
 	.end msgrcv
 
+	.globl Pipe
+	.ent	Pipe
+Pipe:
+	addiu $2,$0,SC_Pipe
+	syscall
+	j	$31
+	.end Pipe
+
+	.globl ExecIO
+	.ent	ExecIO
+ExecIO:
+	addiu $2,$0,SC_ExecIO
+	syscall
+	j	$31
+	.end ExecIO
+
+	.globl Pread
+	.ent	Pread
+Pread:
+	addiu $2,$0,SC_Pread
+	syscall
+	j	$31
+	.end Pread
+
+	.globl Pwrite
+	.ent	Pwrite
+Pwrite:
+	addiu $2,$0,SC_Pwrite
+	syscall
+	j	$31
+	.end Pwrite
+
+	.globl Readv
+	.ent	Readv
+Readv:
+	addiu $2,$0,SC_Readv
+	syscall
+	j	$31
+	.end Readv
+
+	.globl Writev
+	.ent	Writev
+Writev:
+	addiu $2,$0,SC_Writev
+	syscall
+	j	$31
+	.end Writev
+
+	.globl Sleep
+	.ent	Sleep
+Sleep:
+	addiu $2,$0,SC_Sleep
+	syscall
+	j	$31
+	.end Sleep
+
 /* dummy function to keep gcc happy */
         .globl  __main
         .ent    __main
@@ -0,0 +1,178 @@
+// alarm.cc
+//	Routines to put threads to sleep until a given time, and wake
+//	them up again, using a hierarchical timing wheel (cf. alarm.h).
+//
+//	These routines run with interrupts disabled, since the wheel is
+//	also turned by the timer interrupt handler.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "alarm.h"
+#include "system.h"
+
+// dummy function because C++ does not allow pointers to member functions
+static void AlarmHandler(int arg)
+{ Alarm *p = (Alarm *)arg; p->CallBack(); }
+
+//----------------------------------------------------------------------
+// Alarm::Alarm
+//	Initialize an alarm clock with no sleeping threads.  The timer
+//	interrupt is not scheduled until somebody goes to sleep.
+//----------------------------------------------------------------------
+
+Alarm::Alarm()
+{
+    for (int l = 0; l < AlarmLevels; l++)
+	for (int i = 0; i < AlarmSlots; i++)
+	    slots[l][i] = NULL;
+    current = 0;
+    sleeping = 0;
+    armed = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Alarm::~Alarm
+//	De-allocate the alarm clock.  The waiters belong to the sleeping
+//	threads, so there is nothing to free.
+//----------------------------------------------------------------------
+
+Alarm::~Alarm()
+{
+}
+
+//----------------------------------------------------------------------
+// Alarm::WaitUntil
+//	Put the current thread to sleep until the simulated time is at
+//	least "when".  Returns at once if that time has already come.
+//
+//	"when" is the value of totalTicks to wake up at
+//----------------------------------------------------------------------
+
+void
+Alarm::WaitUntil(int when)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    if (when > stats->totalTicks) {
+	AlarmWaiter waiter;
+
+	if (sleeping == 0)		// the wheel is empty, and may have
+	    current = stats->totalTicks / AlarmTick;	// stopped a while ago
+	waiter.due = divRoundUp(when, AlarmTick);
+	waiter.thread = currentThread;
+	Insert(&waiter);
+	sleeping++;
+	if (!armed)
+	    Arm();
+
+	DEBUG('t', "Thread \"%s\" sleeping until %d\n",
+	      currentThread->getName(), when);
+	currentThread->Sleep();
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Alarm::CallBack
+//	Called with interrupts disabled when the timer interrupt occurs.
+//	Turn the wheel up to the present, waking up the threads that
+//	are due, and schedule the next interrupt if anyone still sleeps.
+//----------------------------------------------------------------------
+
+void
+Alarm::CallBack()
+{
+    int now = stats->totalTicks / AlarmTick;
+
+    armed = FALSE;
+    while (current < now)		// normally once
+	Turn();
+    if (sleeping > 0)
+	Arm();
+}
+
+//----------------------------------------------------------------------
+// Alarm::Insert
+//	Put a waiter in the wheel: in level 0 if it is due within
+//	AlarmSlots units, otherwise in the lowest level whose slots
+//	reach that far.  It moves down when its slot comes up.
+//
+//	"waiter" is the thread to wake, and when
+//----------------------------------------------------------------------
+
+void
+Alarm::Insert(AlarmWaiter *waiter)
+{
+    int due = waiter->due;
+    int level = 0;
+
+    while (level < AlarmLevels - 1
+	    && due - current >= (1 << (AlarmSlotBits * (level + 1))))
+	level++;
+    if (due - current >= (1 << (AlarmSlotBits * AlarmLevels)))
+	due = current + (1 << (AlarmSlotBits * AlarmLevels)) - 1;
+					// too far; wait in the last slot
+
+    int slot = (due >> (AlarmSlotBits * level)) & (AlarmSlots - 1);
+    waiter->next = slots[level][slot];
+    slots[level][slot] = waiter;
+}
+
+//----------------------------------------------------------------------
+// Alarm::Turn
+//	Move the wheel on by one unit of time.  Each time a level comes
+//	round to its first slot, the next slot of the level above is
+//	emptied into the levels below it.  Then every thread in the
+//	current slot of level 0 is woken up, unless it is due later
+//	still, in which case it is put back.
+//----------------------------------------------------------------------
+
+void
+Alarm::Turn()
+{
+    AlarmWaiter *waiter, *next;
+
+    current++;
+    for (int level = 1; level < AlarmLevels; level++) {
+	int shift = AlarmSlotBits * level;
+	if ((current & ((1 << shift) - 1)) != 0)
+	    break;			// level below has not wrapped
+	int slot = (current >> shift) & (AlarmSlots - 1);
+	waiter = slots[level][slot];
+	slots[level][slot] = NULL;
+	for (; waiter != NULL; waiter = next) {
+	    next = waiter->next;
+	    Insert(waiter);
+	}
+    }
+
+    int slot = current & (AlarmSlots - 1);
+    waiter = slots[0][slot];
+    slots[0][slot] = NULL;
+    for (; waiter != NULL; waiter = next) {
+	next = waiter->next;
+	if (waiter->due > current)
+	    Insert(waiter);		// was too far to place exactly
+	else {
+	    sleeping--;
+	    scheduler->ReadyToRun(waiter->thread);
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// Alarm::Arm
+//	Schedule the timer interrupt for the end of the current unit of
+//	time.
+//----------------------------------------------------------------------
+
+void
+Alarm::Arm()
+{
+    armed = TRUE;
+    interrupt->Schedule(AlarmHandler, (int)this,
+			(current + 1) * AlarmTick - stats->totalTicks, AlarmInt);
+}
@@ -0,0 +1,71 @@
+// alarm.h
+//	Data structures for an alarm clock, which lets threads sleep
+//	until a given (simulated) time.
+//
+//	Sleeping threads are kept in a hierarchical timing wheel.  Time
+//	is counted in units of AlarmTick ticks; the wheel has AlarmLevels
+//	levels of AlarmSlots slots each, and slot i of level l holds the
+//	threads due in the i'th unit of AlarmSlots^l units.  Each unit
+//	of time looks at a single slot of level 0; once every AlarmSlots
+//	units, the threads in the next slot of level 1 are spread over
+//	level 0, and so on up.  Putting a thread to sleep, and each unit
+//	of time, cost the same however many threads are sleeping.
+//
+//	The wheel is turned by an interrupt from the hardware timer,
+//	which is only scheduled while some thread is asleep.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef ALARM_H
+#define ALARM_H
+
+#include "copyright.h"
+#include "thread.h"
+
+#define AlarmTick	100	// ticks in one turn of the wheel's level 0
+#define AlarmSlotBits	6
+#define AlarmSlots	(1 << AlarmSlotBits)	// slots in each level
+#define AlarmLevels	3	// levels in the wheel; threads due later
+				// than AlarmSlots^AlarmLevels units from
+				// now wait in the last slot of the top one
+
+// A thread waiting for the alarm.  It lives on the thread's own
+// stack while it sleeps, so sleeping allocates nothing.
+
+class AlarmWaiter {
+  public:
+    int due;			// Unit of time to wake up in
+    Thread *thread;		// Thread to wake up
+    AlarmWaiter *next;		// Next waiter in the same slot
+};
+
+// The following class defines the alarm clock.
+
+class Alarm {
+  public:
+    Alarm();			// Initialize an alarm clock, with nobody
+				// sleeping
+    ~Alarm();
+
+    void WaitUntil(int when);	// Put the current thread to sleep until
+				// totalTicks reaches "when" (rounded up
+				// to the next AlarmTick)
+    void CallBack();		// Called by the timer interrupt handler
+
+  private:
+    AlarmWaiter *slots[AlarmLevels][AlarmSlots];
+				// Threads sleeping, by when they are due
+    int current;		// Last unit of time the wheel was turned to
+    int sleeping;		// Number of threads in the wheel
+    bool armed;			// Is the timer interrupt scheduled?
+
+    void Insert(AlarmWaiter *waiter);	// Put a waiter in its slot
+    void Turn();		// Move on to the next unit of time, waking
+				// up whoever is due in it
+    void Arm();			// Schedule the interrupt for the end of
+				// the current unit
+};
+
+#endif // ALARM_H
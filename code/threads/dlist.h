@@ -0,0 +1,172 @@
+// dlist.h
+//	Data structures to manage doubly linked lists whose links are
+//	kept in the items themselves.
+//
+//	A List allocates a ListElement for every item put on it, and
+//	can only find an item in the middle by walking the list.  A
+//	DList instead links its items through a DLink embedded in each
+//	of them, so putting an item on the list or taking it off --
+//	from the front or from anywhere in the list -- takes constant
+//	time, and never calls the allocator.  The price is that an item
+//	can be on only one list per DLink it contains.
+//
+//	These lists are used for the queues of threads that are ready,
+//	or waiting on a synchronization primitive; a thread is on at
+//	most one of them at a time, so one link is enough.
+//
+//	We assume mutual exclusion is provided by the caller.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef DLIST_H
+#define DLIST_H
+
+#include "copyright.h"
+#include "utility.h"
+
+// The following class defines the link fields that an item must
+// contain, for each list it can be on.
+
+template <class T>
+class DLink {
+  public:
+    DLink() { prev = next = NULL; }
+
+    T *prev;			// item before us on the list, NULL if first
+    T *next;			// item after us, NULL if last
+};
+
+// The following class defines a list of items of type T, linked
+// through their member "link".  Like List, it does not own its items.
+
+template <class T, DLink<T> T::*link>
+class DList {
+  public:
+    DList() { first = last = NULL; numInList = 0; }
+				// initialize the list
+    ~DList() {}			// de-allocate the list; the items on it
+				// are not touched
+
+    void Prepend(T *item);	// Put item at the beginning of the list
+    void Append(T *item);	// Put item at the end of the list
+    T *Remove();		// Take item off the front of the list,
+				// NULL if the list is empty
+    void Remove(T *item);	// Take a specific item off the list
+
+    T *First() { return first; }	// Front of the list, NULL if empty
+    void Mapcar(VoidFunctionPtr func);	// Apply "func" to every item
+					// on the list
+    int NumInList() { return numInList; }
+    bool IsEmpty() { return first == NULL; }
+
+  private:
+    T *first;			// Head of the list, NULL if list is empty
+    T *last;			// Last item on the list
+    int numInList;		// number of items on the list
+};
+
+//----------------------------------------------------------------------
+// DList::Prepend
+//	Put an item at the front of the list.
+//
+//	"item" is the thing to put on the list; it must not be on any
+//	other list through the same link
+//----------------------------------------------------------------------
+
+template <class T, DLink<T> T::*link>
+void
+DList<T, link>::Prepend(T *item)
+{
+    (item->*link).prev = NULL;
+    (item->*link).next = first;
+    if (first == NULL)
+	last = item;
+    else
+	(first->*link).prev = item;
+    first = item;
+    numInList++;
+}
+
+//----------------------------------------------------------------------
+// DList::Append
+//	Put an item at the end of the list.
+//
+//	"item" is the thing to put on the list; it must not be on any
+//	other list through the same link
+//----------------------------------------------------------------------
+
+template <class T, DLink<T> T::*link>
+void
+DList<T, link>::Append(T *item)
+{
+    (item->*link).prev = last;
+    (item->*link).next = NULL;
+    if (last == NULL)
+	first = item;
+    else
+	(last->*link).next = item;
+    last = item;
+    numInList++;
+}
+
+//----------------------------------------------------------------------
+// DList::Remove
+//	Take the first item off the list, and return it.  Returns NULL
+//	if the list is empty.
+//----------------------------------------------------------------------
+
+template <class T, DLink<T> T::*link>
+T *
+DList<T, link>::Remove()
+{
+    T *item = first;
+
+    if (item != NULL)
+	Remove(item);
+    return item;
+}
+
+//----------------------------------------------------------------------
+// DList::Remove
+//	Take an item off the list, wherever it is.
+//
+//	"item" is the thing to take off; it must be on this list
+//----------------------------------------------------------------------
+
+template <class T, DLink<T> T::*link>
+void
+DList<T, link>::Remove(T *item)
+{
+    DLink<T> *l = &(item->*link);
+
+    if (l->prev == NULL)
+	first = l->next;
+    else
+	(l->prev->*link).next = l->next;
+    if (l->next == NULL)
+	last = l->prev;
+    else
+	(l->next->*link).prev = l->prev;
+    l->prev = l->next = NULL;
+    numInList--;
+}
+
+//----------------------------------------------------------------------
+// DList::Mapcar
+//	Apply a function to each item on the list, front to back.  The
+//	function must not take the item off the list.
+//
+//	"func" is the procedure to apply; it is passed the item
+//----------------------------------------------------------------------
+
+template <class T, DLink<T> T::*link>
+void
+DList<T, link>::Mapcar(VoidFunctionPtr func)
+{
+    for (T *item = first; item != NULL; item = (item->*link).next)
+	(*func)((int)item);
+}
+
+#endif // DLIST_H
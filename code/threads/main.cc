@@ -8,9 +8,9 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
+// Usage: nachos -d <debugflags> -rs <random seed #> -sched <policy>
 //		-s -x <nachos file> -c <consoleIn> <consoleOut>
-//		-f -cp <unix file> <nachos file>
+//		-f -ds <policy> -dm -cp <unix file> <nachos file>
 //		-p <nachos file> -r <nachos file> -l -D -t
 //              -n <network reliability> -m <machine id>
 //              -o <other machine id>
@@ -18,6 +18,7 @@
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -sched sets the CPU scheduling policy: priority, mlfq or fair
 //    -z prints the copyright message
 //
 //  USER_PROGRAM
@@ -27,6 +28,8 @@
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
+//    -ds sets the disk scheduling policy: fcfs, sstf, scan or clook
+//    -dm maps the disk file into memory, for a faster simulation
 //    -cp copies a file from UNIX to Nachos
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
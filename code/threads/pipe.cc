@@ -0,0 +1,164 @@
+// pipe.cc 
+//	Routines for a bounded buffer of bytes, shared by the threads
+//	at both ends of a pipe.
+//
+// 	Implemented in "monitor"-style -- surround each procedure with a
+// 	lock acquire and release pair, using condition signal and wait for
+// 	synchronization.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "pipe.h"
+
+//----------------------------------------------------------------------
+// PipeBuffer::PipeBuffer
+//	Allocate and initialize an empty pipe, with one read end and one
+//	write end open.
+//
+//	"size" is the number of bytes the pipe can hold
+//----------------------------------------------------------------------
+
+PipeBuffer::PipeBuffer(int size)
+{
+    buffer = new char[size];
+    this->size = size;
+    head = count = 0;
+    readers = writers = 1;
+    lock = new Lock("pipe lock");
+    notEmpty = new Condition("pipe not empty");
+    notFull = new Condition("pipe not full");
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::~PipeBuffer
+//	De-allocate a pipe.  Nobody may be using it any more.
+//----------------------------------------------------------------------
+
+PipeBuffer::~PipeBuffer()
+{
+    delete [] buffer;
+    delete lock;
+    delete notEmpty;
+    delete notFull;
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::Read
+//	Take up to "numBytes" bytes out of the pipe.  Wait until there is
+//	at least one, or until nobody can write any more.  Return the
+//	number of bytes read, 0 at end of file.
+//
+//	"into" -- the buffer to hold the bytes read
+//----------------------------------------------------------------------
+
+int
+PipeBuffer::Read(char *into, int numBytes)
+{
+    int done = 0;
+
+    lock->Acquire();
+    while (count == 0 && writers > 0)
+	notEmpty->Wait(lock);
+    while (done < numBytes && count > 0) {
+	// copy the run up to the end of the buffer, then the rest
+	int chunk = numBytes - done;
+	if (chunk > count)
+	    chunk = count;
+	if (chunk > size - head)
+	    chunk = size - head;
+	bcopy(&buffer[head], &into[done], chunk);
+	head = (head + chunk) % size;
+	count -= chunk;
+	done += chunk;
+    }
+    if (done > 0)
+	notFull->Broadcast(lock);	// wake up writers, if any
+    lock->Release();
+    return done;
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::Write
+//	Put "numBytes" bytes into the pipe, waiting for readers to make
+//	room as often as needed.  Return the number of bytes written, or
+//	-1 if every read end is closed before they are all written.
+//
+//	"from" -- the bytes to write
+//----------------------------------------------------------------------
+
+int
+PipeBuffer::Write(char *from, int numBytes)
+{
+    int done = 0;
+
+    lock->Acquire();
+    while (done < numBytes && readers > 0) {
+	if (count == size) {
+	    notFull->Wait(lock);
+	    continue;
+	}
+	int tail = (head + count) % size;
+	int chunk = numBytes - done;
+	if (chunk > size - count)
+	    chunk = size - count;
+	if (chunk > size - tail)
+	    chunk = size - tail;
+	bcopy(&from[done], &buffer[tail], chunk);
+	count += chunk;
+	done += chunk;
+	notEmpty->Broadcast(lock);	// wake up readers, if any
+    }
+    lock->Release();
+    return (done < numBytes) ? -1 : done;
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::OpenEnd
+//	Note that one more thread uses an end of the pipe.
+//
+//	"writing" -- the write end, rather than the read end
+//----------------------------------------------------------------------
+
+void
+PipeBuffer::OpenEnd(bool writing)
+{
+    lock->Acquire();
+    if (writing)
+	writers++;
+    else
+	readers++;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::CloseEnd
+//	Note that one thread stopped using an end of the pipe.  When the
+//	last writer goes, waiting readers see end of file; when the last
+//	reader goes, waiting writers fail.  Return TRUE if both ends are
+//	closed, so the caller should delete the pipe.
+//
+//	"writing" -- the write end, rather than the read end
+//----------------------------------------------------------------------
+
+bool
+PipeBuffer::CloseEnd(bool writing)
+{
+    bool unused;
+
+    lock->Acquire();
+    if (writing) {
+	ASSERT(writers > 0);
+	if (--writers == 0)
+	    notEmpty->Broadcast(lock);
+    } else {
+	ASSERT(readers > 0);
+	if (--readers == 0)
+	    notFull->Broadcast(lock);
+    }
+    unused = (readers == 0 && writers == 0);
+    lock->Release();
+    return unused;
+}
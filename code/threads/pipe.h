@@ -0,0 +1,64 @@
+// pipe.h 
+//	Data structures for a pipe -- a bounded buffer of bytes in
+//	memory, written at one end and read at the other, for passing
+//	data between threads (or user programs) without going through
+//	the disk.
+//
+//	Implemented in "monitor"-style, like SynchList: one lock guards
+//	the buffer, and readers and writers wait on a condition variable
+//	for data, or for room, to appear.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PIPE_H
+#define PIPE_H
+
+#include "copyright.h"
+#include "synch.h"
+
+#define PipeSize	512	// bytes buffered in a pipe
+
+// The following class defines a pipe.  Each end may be open any
+// number of times (for instance, once in the shell and once in the
+// program it started); the pipe goes away when every open end has
+// been closed.
+//
+// Once every write end is closed, a Read returns what is left in the
+// buffer, and then 0 for "end of file".  Once every read end is
+// closed, nobody will ever read what is written, so Write fails.
+
+class PipeBuffer {
+  public:
+    PipeBuffer(int size = PipeSize);
+				// initialize a pipe, with one read end
+				// and one write end open
+    ~PipeBuffer();		// de-allocate a pipe
+
+    int Read(char *into, int numBytes);
+				// read up to numBytes, waiting until at
+				// least one byte is there; return 0
+				// at end of file
+    int Write(char *from, int numBytes);
+				// write numBytes, waiting for room as
+				// needed; return -1 if nobody reads
+
+    void OpenEnd(bool writing);	// one more user of an end
+    bool CloseEnd(bool writing);// one user less; return TRUE if the
+				// pipe is no longer used, and should
+				// be deleted
+
+  private:
+    char *buffer;		// ring buffer of "size" bytes
+    int size;
+    int head;			// where the next byte is read from
+    int count;			// bytes in the buffer
+    int readers;		// read ends open
+    int writers;		// write ends open
+    Lock *lock;			// enforce mutual exclusive access
+    Condition *notEmpty;	// wait in Read until there is data
+    Condition *notFull;		// wait in Write until there is room
+};
+
+#endif // PIPE_H
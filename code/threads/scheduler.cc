@@ -11,8 +11,10 @@
 //	end up calling FindNextToRun(), and that would put us in an 
 //	infinite loop.
 //
-// 	Very simple implementation -- no priorities, straight FIFO.
-//	Might need to be improved in later assignments.
+// 	Threads run in order of priority (0 is the highest), and FIFO
+//	among threads of the same priority.  The priority is either the
+//	thread's own, or its level in a multi-level feedback queue (cf.
+//	scheduler.h).
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -24,28 +26,41 @@
 
 //----------------------------------------------------------------------
 // Scheduler::Scheduler
-// 	Initialize the list of ready but not running threads to empty.
+// 	Initialize the lists of ready but not running threads to empty.
+//
+//	"policy" is how threads are given their priority
 //----------------------------------------------------------------------
 
-Scheduler::Scheduler()
+Scheduler::Scheduler(SchedPolicy policy)
 { 
-    readyList = new List; 
+    this->policy = policy;
+    readyMask = 0;
+    nextBoost = MLFQBoostTicks;
+    fairCapacity = 16;
+    fairHeap = new Thread *[fairCapacity];
+    fairCount = 0;
+    minVruntime = 0;
+    quantumTimer = NULL;
 } 
 
 //----------------------------------------------------------------------
 // Scheduler::~Scheduler
-// 	De-allocate the list of ready threads.
+// 	De-allocate the lists of ready threads.
 //----------------------------------------------------------------------
 
 Scheduler::~Scheduler()
 { 
-    delete readyList; 
+    delete [] fairHeap;
 } 
 
 //----------------------------------------------------------------------
 // Scheduler::ReadyToRun
 // 	Mark a thread as ready, but not running.
-//	Put it on the ready list, for later scheduling onto the CPU.
+//	Put it at the end of the ready list for its priority, for later
+//	scheduling onto the CPU.
+//
+//	If it is the current thread, giving up the CPU, the time it ran
+//	is charged to it first.
 //
 //	"thread" is the thread to be put on the ready list.
 //----------------------------------------------------------------------
@@ -55,8 +70,27 @@ Scheduler::ReadyToRun (Thread *thread)
 {
     DEBUG('t', "Putting thread %s on ready list.\n", thread->getName());
 
+    if (thread == currentThread)
+	Charge(thread, FALSE);		// and Run sets the timer
+    else if (quantumTimer == NULL && currentThread->getStatus() == RUNNING)
+	StartQuantum();			// someone is waiting now
+    if (policy == SchedFair) {
+	// a thread that was away does not get to catch up on the time
+	// it missed, or it would have the CPU to itself for that long
+	if (thread != currentThread && thread->vruntime < minVruntime)
+	    thread->vruntime = minVruntime;
+	thread->setStatus(READY);
+	thread->readySince = stats->totalTicks;
+	FairInsert(thread);
+	return;
+    }
+    int priority = (policy == SchedMLFQ) ? thread->level
+					 : thread->getPriority();
+    ASSERT(priority >= 0 && priority < PriorityLevelSize);
     thread->setStatus(READY);
-    readyList->SortedInsert((void *)thread, thread->getPriority());
+    thread->readySince = stats->totalTicks;
+    readyList[priority].Append(thread);
+    readyMask |= 1u << priority;
 }
 
 //----------------------------------------------------------------------
@@ -65,12 +99,32 @@ Scheduler::ReadyToRun (Thread *thread)
 //	If there are no ready threads, return NULL.
 // Side effect:
 //	Thread is removed from the ready list.
+//
+//	The lowest bit set in the bit map is the highest priority with
+//	a ready thread.
 //----------------------------------------------------------------------
 
 Thread *
 Scheduler::FindNextToRun ()
 {
-    return (Thread *)readyList->Remove();
+    if (policy == SchedFair) {
+	Thread *thread = FairRemove();
+	if (thread != NULL && thread->vruntime > minVruntime)
+	    minVruntime = thread->vruntime;
+	return thread;
+    }
+    if (policy == SchedMLFQ && stats->totalTicks >= nextBoost) {
+	Boost();
+	nextBoost = stats->totalTicks + MLFQBoostTicks;
+    }
+    if (readyMask == 0)
+	return NULL;
+
+    int priority = __builtin_ctz(readyMask);
+    Thread *thread = readyList[priority].Remove();
+    if (readyList[priority].IsEmpty())
+	readyMask &= ~(1u << priority);
+    return thread;
 }
 
 //----------------------------------------------------------------------
@@ -102,10 +156,18 @@ Scheduler::Run (Thread *nextThread)
     oldThread->CheckOverflow();		    // check if the old thread
 					    // had an undetected stack overflow
 
+    if (oldThread->getStatus() != READY)    // blocked, or finished; if
+	Charge(oldThread, TRUE);	    // READY, it has been charged
+    StopQuantum();			    // the slice was oldThread's
+
     currentThread = nextThread;		    // switch to the next thread
     currentThread->setStatus(RUNNING);      // nextThread is now running
     
     currentThread->setStartTime(stats->totalTicks);
+    currentThread->waitTicks += stats->totalTicks - currentThread->readySince;
+    if (currentThread->firstRunTime == -1)
+	currentThread->firstRunTime = stats->totalTicks;
+    StartQuantum();
 
     DEBUG('t', "Switching from thread \"%s\" to thread \"%s\"\n",
 	  oldThread->getName(), nextThread->getName());
@@ -135,6 +197,197 @@ Scheduler::Run (Thread *nextThread)
 #endif
 }
 
+//----------------------------------------------------------------------
+// Scheduler::StartQuantum
+// 	If any thread is waiting for the CPU, schedule a timer interrupt
+//	for when the current thread's time slice runs out: TimeSlice
+//	after it was dispatched, or with SchedMLFQ, when it has used
+//	the quantum of its level.  (With SchedFair the slices are the
+//	same for everyone; the shares come from the order of the heap.)
+//----------------------------------------------------------------------
+
+static void
+QuantumHandler(int arg)
+{
+    ((Scheduler *)arg)->QuantumExpired();
+}
+
+void
+Scheduler::StartQuantum()
+{
+    if (quantumTimer != NULL || IsEmpty())
+	return;
+
+    int slice = TimeSlice;
+    if (policy == SchedMLFQ)
+	slice = (TimeSlice << currentThread->level) - currentThread->quantumUsed;
+    int left = slice - (stats->totalTicks - currentThread->getStartTime());
+    if (left < 1)
+	left = 1;			// overdue; as soon as possible
+    quantumTimer = interrupt->Schedule(QuantumHandler, (int)this, left,
+					TimerInt);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::StopQuantum
+// 	Cancel the time slice timer, if it is set.
+//----------------------------------------------------------------------
+
+void
+Scheduler::StopQuantum()
+{
+    if (quantumTimer != NULL) {
+	interrupt->Cancel(quantumTimer);
+	quantumTimer = NULL;
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::QuantumExpired
+// 	Called, with interrupts disabled, when the current thread's time
+//	slice is over.  As in TimerInterruptHandler, we cannot Yield
+//	here; the thread yields once the interrupt handler returns, and
+//	the next dispatch sets the timer again if need be.
+//----------------------------------------------------------------------
+
+void
+Scheduler::QuantumExpired()
+{
+    quantumTimer = NULL;		// the interrupt is over and done with
+    if (interrupt->getStatus() != IdleMode)
+	interrupt->YieldOnReturn();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Charge
+// 	Add the time "thread" has run since it was last dispatched to
+//	its statistics.  With SchedMLFQ, a thread that has used up its
+//	quantum moves down a level; one that blocks moves up a level.
+//
+//	"thread" is the thread giving up the CPU
+//	"blocking" is TRUE if it is going to wait, rather than be ready
+//----------------------------------------------------------------------
+
+void
+Scheduler::Charge(Thread *thread, bool blocking)
+{
+    int ran = stats->totalTicks - thread->getStartTime();
+
+    thread->runTicks += ran;
+    if (policy == SchedFair)
+	thread->vruntime += ran * DefaultWeight / thread->weight;
+    if (policy != SchedMLFQ)
+	return;
+    thread->quantumUsed += ran;
+    if (blocking) {
+	if (thread->level > 0)
+	    thread->level--;
+	thread->quantumUsed = 0;
+    } else if (thread->quantumUsed >= (TimeSlice << thread->level)) {
+	if (thread->level < MLFQLevels - 1)
+	    thread->level++;
+	thread->quantumUsed = 0;
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Boost
+// 	Put every thread back at level 0, moving the ready ones to the
+//	end of the level 0 list, in the order they were ready.
+//----------------------------------------------------------------------
+
+static void
+ResetLevel(int arg)
+{
+    Thread *thread = (Thread *)arg;
+
+    thread->level = 0;
+    thread->quantumUsed = 0;
+}
+
+void
+Scheduler::Boost()
+{
+    DEBUG('t', "Boosting all threads to level 0\n");
+
+    threadTable->Mapcar((VoidFunctionPtr) ResetLevel);
+    for (int i = 1; i < MLFQLevels; i++) {
+	Thread *thread;
+	while ((thread = readyList[i].Remove()) != NULL)
+	    readyList[0].Append(thread);
+    }
+    if (readyMask != 0)
+	readyMask = 1;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::FairInsert
+// Scheduler::FairRemove
+// 	Put a thread into the heap of ready threads used by SchedFair,
+//	or take out the one to run next (NULL if there is none).  The
+//	heap is kept in an array, with the children of entry i at 2i+1
+//	and 2i+2; it grows when it is full.
+//----------------------------------------------------------------------
+
+void
+Scheduler::FairInsert(Thread *thread)
+{
+    if (fairCount == fairCapacity) {
+	Thread **bigger = new Thread *[2 * fairCapacity];
+	for (int i = 0; i < fairCount; i++)
+	    bigger[i] = fairHeap[i];
+	delete [] fairHeap;
+	fairHeap = bigger;
+	fairCapacity *= 2;
+    }
+
+    int i = fairCount++;
+    while (i > 0 && FairBefore(thread, fairHeap[(i - 1) / 2])) {
+	fairHeap[i] = fairHeap[(i - 1) / 2];
+	i = (i - 1) / 2;
+    }
+    fairHeap[i] = thread;
+}
+
+Thread *
+Scheduler::FairRemove()
+{
+    if (fairCount == 0)
+	return NULL;
+
+    Thread *first = fairHeap[0];
+    Thread *last = fairHeap[--fairCount];
+    int i = 0;
+    for (;;) {
+	int child = 2 * i + 1;
+	if (child >= fairCount)
+	    break;
+	if (child + 1 < fairCount 
+		&& FairBefore(fairHeap[child + 1], fairHeap[child]))
+	    child++;
+	if (!FairBefore(fairHeap[child], last))
+	    break;
+	fairHeap[i] = fairHeap[child];
+	i = child;
+    }
+    fairHeap[i] = last;
+    return first;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::FairBefore
+// 	Return TRUE if thread "a" should run before thread "b": it has
+//	run less, in virtual time, or as much, but has waited longer.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::FairBefore(Thread *a, Thread *b)
+{
+    if (a->vruntime != b->vruntime)
+	return a->vruntime < b->vruntime;
+    return a->readySince < b->readySince;
+}
+
 //----------------------------------------------------------------------
 // Scheduler::Print
 // 	Print the scheduler state -- in other words, the contents of
@@ -144,5 +397,8 @@ void
 Scheduler::Print()
 {
     printf("Ready list contents:\n");
-    readyList->Mapcar((VoidFunctionPtr) ThreadPrint);
+    for (int i = 0; i < fairCount; i++)
+	ThreadPrint((int)fairHeap[i]);
+    for (int i = 0; i < PriorityLevelSize; i++)
+	readyList[i].Mapcar((VoidFunctionPtr) ThreadPrint);
 }
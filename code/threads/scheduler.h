@@ -10,27 +10,93 @@
 #define SCHEDULER_H
 
 #include "copyright.h"
-#include "list.h"
 #include "thread.h"
 
+class PendingInterrupt;
+
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
 // thread is running, and which threads are ready but not running.
+//
+// Ready threads are kept in one FIFO list per priority level, and a
+// bit map says which lists are not empty, so that both putting a
+// thread on the ready list and finding the next one take constant
+// time, however many threads there are.
+//
+// Two policies decide a thread's priority level:
+//   SchedPriority -- the thread's own, fixed priority; threads of the
+//	same priority share the CPU round-robin, in slices of TimeSlice
+//   SchedMLFQ -- a multi-level feedback queue.  Threads start at level
+//	0, and move down a level each time they use up the quantum of
+//	their level, which doubles from one level to the next; a thread
+//	that blocks before that moves up a level.  Every MLFQBoostTicks,
+//	all threads are put back at level 0, so none starves.
+//
+// A third policy, SchedFair, ignores priorities and shares the CPU in
+// proportion to the threads' weights.  Each thread's virtual runtime
+// grows by the ticks it runs, scaled by DefaultWeight / weight, and
+// the ready thread with the smallest virtual runtime runs next; the
+// ready threads are kept in a heap ordered by it.
+//
+// The end of a time slice is signalled by a timer interrupt, which is
+// only scheduled while some thread is waiting for the CPU: when a
+// thread is dispatched with others ready, or a thread becomes ready
+// while another runs.  It is cancelled when the running thread gives
+// up the CPU, so an idle machine, or one with a single runnable
+// thread, takes no timer interrupts at all.
+
+enum SchedPolicy { SchedPriority, SchedMLFQ, SchedFair };
+
+#define TimeSlice	150	// ticks a thread runs before others of the
+				// same priority get the CPU
+#define MLFQLevels	4	// levels used by SchedMLFQ
+#define MLFQBoostTicks	10000	// how often all threads go back to level 0
 
 class Scheduler {
   public:
-    Scheduler();			// Initialize list of ready threads 
+    Scheduler(SchedPolicy policy = SchedPriority);
+					// Initialize list of ready threads 
     ~Scheduler();			// De-allocate ready list
 
     void ReadyToRun(Thread* thread);	// Thread can be dispatched.
     Thread* FindNextToRun();		// Dequeue first thread on the ready 
 					// list, if any, and return thread.
     void Run(Thread* nextThread);	// Cause nextThread to start running
+    void QuantumExpired();		// Called by the time slice timer
     void Print();			// Print contents of ready list
     
   private:
-    List *readyList;  		// queue of threads that are ready to run,
-				// but not running
+    SchedPolicy policy;
+    ThreadQueue readyList[PriorityLevelSize];
+				// queues of threads that are ready to run,
+				// but not running, one per priority
+    unsigned int readyMask;	// bit i is set if readyList[i] is not
+				// empty
+    int nextBoost;		// when SchedMLFQ next resets all levels
+    PendingInterrupt *quantumTimer;
+				// interrupt ending the current thread's
+				// time slice, NULL if none is set
+
+    Thread **fairHeap;		// ready threads under SchedFair, as a
+				// heap ordered by virtual runtime
+    int fairCount;		// threads in the heap
+    int fairCapacity;		// room in the heap, before it grows
+    int minVruntime;		// virtual runtime of the thread last
+				// picked; never decreases
+
+    bool IsEmpty() { return readyMask == 0 && fairCount == 0; }
+				// Is no thread ready?
+    void StartQuantum();	// Set the time slice timer, if threads
+				// are waiting for the CPU
+    void StopQuantum();		// Cancel the time slice timer
+    void Charge(Thread *thread, bool blocking);
+				// Account for the time "thread" ran
+    void Boost();		// Put every thread back at level 0
+
+    void FairInsert(Thread *thread);	// Put a thread in the heap
+    Thread *FairRemove();		// Take out the smallest, or NULL
+    bool FairBefore(Thread *a, Thread *b);
+					// Should "a" run before "b"?
 };
 
 #endif // SCHEDULER_H
@@ -37,7 +37,6 @@ Semaphore::Semaphore(char* debugName, int initialValue)
 {
     name = debugName;
     value = initialValue;
-    queue = new List;
 }
 
 //----------------------------------------------------------------------
@@ -48,7 +47,6 @@ Semaphore::Semaphore(char* debugName, int initialValue)
 
 Semaphore::~Semaphore()
 {
-    delete queue;
 }
 
 //----------------------------------------------------------------------
@@ -67,7 +65,7 @@ Semaphore::P()
     IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
     
     while (value == 0) { 			// semaphore not available
-	queue->Append((void *)currentThread);	// so go to sleep
+	queue.Append(currentThread);	// so go to sleep
 	currentThread->Sleep();
     } 
     value--; 					// semaphore available, 
@@ -90,7 +88,7 @@ Semaphore::V()
     Thread *thread;
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
 
-    thread = (Thread *)queue->Remove();
+    thread = queue.Remove();
     if (thread != NULL)	   // make thread ready, consuming the V immediately
 	scheduler->ReadyToRun(thread);
     value++;
@@ -105,14 +103,19 @@ Lock::Lock(char* debugName)
     name = debugName;
     state = FREE;
     holder = NULL;
-    queue = new List;
 }
 
 Lock::~Lock() 
 {
-    delete queue;
 }
 
+//----------------------------------------------------------------------
+// Lock::Acquire
+// 	Wait until the lock is free, then take it.  A thread that has to
+//	wait is handed the lock by Release, so it holds the lock when
+//	it wakes up, and nobody can take the lock in between.
+//----------------------------------------------------------------------
+
 void Lock::Acquire() 
 {
     
@@ -120,16 +123,24 @@ void Lock::Acquire()
 
     IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
     
-    while (state == BUSY) { 			// lock not available
-	    queue->Append((void *)currentThread);	// so go to sleep
+    if (state == BUSY) { 			// lock not available
+	    queue.Append(currentThread);	// so go to sleep
 	    currentThread->Sleep();
-    } 
-    state = BUSY; 					// lock available, acquire it
-	holder = currentThread;			// remember the holder
+	    ASSERT(holder == currentThread);	// Release gave it to us
+    } else {
+	    state = BUSY; 			// lock available, acquire it
+	    holder = currentThread;		// remember the holder
+    }
     
     (void) interrupt->SetLevel(oldLevel);	// re-enable interrupts
 }
 
+//----------------------------------------------------------------------
+// Lock::Release
+// 	Give the lock to the first waiting thread, and make it ready;
+//	the lock only becomes free if nobody is waiting.
+//----------------------------------------------------------------------
+
 void Lock::Release() 
 {
     ASSERT(isHeldByCurrentThread());
@@ -137,11 +148,14 @@ void Lock::Release()
     Thread *thread;
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
 
-    thread = (Thread *)queue->Remove();
-    if (thread != NULL)	   // make thread ready, acquiring the lock immediately
+    thread = queue.Remove();
+    if (thread != NULL) {  // make thread ready, acquiring the lock immediately
+	    holder = thread;
 	    scheduler->ReadyToRun(thread);
-    state = FREE;
-    holder = NULL;
+    } else {
+	    state = FREE;
+	    holder = NULL;
+    }
 
     (void) interrupt->SetLevel(oldLevel);
 }
@@ -160,14 +174,19 @@ bool Lock::isHeldByCurrentThread()
 Condition::Condition(char* debugName) 
 {
     name = debugName;
-    queue = new List;
 }
 
 Condition::~Condition() 
 {
-    delete queue;
 }
 
+//----------------------------------------------------------------------
+// Condition::Wait
+// 	Release the lock and go to sleep, until a Signal or Broadcast
+//	moves us to the lock's queue and the lock is handed to us.  So
+//	when we wake up, we already hold the lock again.
+//----------------------------------------------------------------------
+
 void Condition::Wait(Lock* conditionLock) 
 {
     ASSERT(conditionLock->isHeldByCurrentThread());
@@ -175,13 +194,21 @@ void Condition::Wait(Lock* conditionLock)
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
 
     conditionLock->Release();
-    queue->Append((void *)currentThread);
+    queue.Append(currentThread);
 	currentThread->Sleep();
-    conditionLock->Acquire();
+    ASSERT(conditionLock->isHeldByCurrentThread());
 
     (void) interrupt->SetLevel(oldLevel);
 }
 
+//----------------------------------------------------------------------
+// Condition::Signal
+// 	Move the first waiting thread, if any, onto the lock's queue.
+//	The signaller holds the lock, so the thread could not get any
+//	further if it were woken now; instead it stays asleep until the
+//	lock is handed to it, which wakes it up just once.
+//----------------------------------------------------------------------
+
 void Condition::Signal(Lock* conditionLock) 
 {
     ASSERT(conditionLock->isHeldByCurrentThread());
@@ -189,13 +216,20 @@ void Condition::Signal(Lock* conditionLock)
     Thread *thread;
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
 
-    thread = (Thread *)queue->Remove();
+    thread = queue.Remove();
     if (thread != NULL)
-	    scheduler->ReadyToRun(thread);
+	    conditionLock->queue.Append(thread);
 
     (void) interrupt->SetLevel(oldLevel);
 }
 
+//----------------------------------------------------------------------
+// Condition::Broadcast
+// 	Move all the waiting threads onto the lock's queue, in the order
+//	they waited.  They are woken one at a time, as each in turn is
+//	handed the lock, rather than all at once to fight over it.
+//----------------------------------------------------------------------
+
 void Condition::Broadcast(Lock* conditionLock) 
 {
     ASSERT(conditionLock->isHeldByCurrentThread());
@@ -203,12 +237,8 @@ void Condition::Broadcast(Lock* conditionLock)
     Thread *thread;
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
 
-    thread = (Thread *)queue->Remove();
-    while (thread != NULL)
-    {
-        scheduler->ReadyToRun(thread);
-        thread = (Thread *)queue->Remove();
-    }
+    while ((thread = queue.Remove()) != NULL)
+        conditionLock->queue.Append(thread);
 	    
     (void) interrupt->SetLevel(oldLevel);
 }
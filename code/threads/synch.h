@@ -19,7 +19,6 @@
 
 #include "copyright.h"
 #include "thread.h"
-#include "list.h"
 
 // The following class defines a "semaphore" whose value is a non-negative
 // integer.  The semaphore has only two operations P() and V():
@@ -48,7 +47,7 @@ class Semaphore {
   private:
     char* name;        // useful for debugging
     int value;         // semaphore value, always >= 0
-    List *queue;       // threads waiting in P() for the value to be > 0
+    ThreadQueue queue;       // threads waiting in P() for the value to be > 0
 };
 
 // The following class defines a "lock".  A lock can be BUSY or FREE.
@@ -56,8 +55,8 @@ class Semaphore {
 //
 //	Acquire -- wait until the lock is FREE, then set it to BUSY
 //
-//	Release -- set lock to be FREE, waking up a thread waiting
-//		in Acquire if necessary
+//	Release -- hand the lock to a thread waiting in Acquire, and
+//		wake it up; set the lock to be FREE if nobody is waiting
 //
 // In addition, by convention, only the thread that acquired the lock
 // may release it.  As with semaphores, you can't read the lock value
@@ -83,7 +82,10 @@ class Lock {
     char* name;				// for debugging
     LockStates state; // lock state
     Thread  *holder;  // lock holder
-    List *queue;       // threads waiting to acquire
+    ThreadQueue queue;       // threads waiting to acquire; Release
+			     // hands the lock to the first of them
+
+    friend class Condition;  // moves its waiters onto our queue
 };
 
 // The following class defines a "condition variable".  A condition
@@ -106,17 +108,22 @@ class Lock {
 //
 // In Nachos, condition variables are assumed to obey *Mesa*-style
 // semantics.  When a Signal or Broadcast wakes up another thread,
-// it simply puts the thread on the ready list, and it is the responsibility
-// of the woken thread to re-acquire the lock (this re-acquire is
-// taken care of within Wait()).  By contrast, some define condition
-// variables according to *Hoare*-style semantics -- where the signalling
-// thread gives up control over the lock and the CPU to the woken thread,
-// which runs immediately and gives back control over the lock to the 
-// signaller when the woken thread leaves the critical section.
+// the signaller keeps running, and the woken thread has to re-acquire
+// the lock before it can return from Wait().  By contrast, some define
+// condition variables according to *Hoare*-style semantics -- where the
+// signalling thread gives up control over the lock and the CPU to the
+// woken thread, which runs immediately and gives back control over the
+// lock to the signaller when the woken thread leaves the critical section.
+//
+// Since the signaller holds the lock, a woken thread could only go
+// back to sleep waiting for it.  So Signal and Broadcast do not make
+// the thread ready; they move it straight onto the lock's queue, and
+// the lock is handed to it when its turn comes, waking it up once
+// ("wait morphing").
 //
-// The consequence of using Mesa-style semantics is that some other thread
-// can acquire the lock, and change data structures, before the woken
-// thread gets a chance to run.
+// The consequence of using Mesa-style semantics is that other threads
+// waiting for the lock, or the signaller itself, can change data
+// structures before the woken thread gets a chance to run.
 
 class Condition {
   public:
@@ -135,7 +142,7 @@ class Condition {
 
   private:
     char* name;
-    List *queue;       // threads waiting for condition variable
+    ThreadQueue queue;       // threads waiting for condition variable
 };
 
 enum ReadWriteType { MYREAD, MYWRITE };
@@ -18,8 +18,8 @@ Interrupt *interrupt;			// interrupt status
 Statistics *stats;			// performance metrics
 Timer *timer;				// the hardware timer device,
 					// for invoking context switches
-Timer *RRTimer;     // timer for RR scheduling
-List *threadList;   // a list of threads
+Alarm *alarmClock;			// threads sleeping until a given time
+ThreadTable *threadTable;		// every thread, by tid
 
 #ifdef FILESYS_NEEDED
 FileSystem  *fileSystem;
@@ -27,6 +27,8 @@ FileSystem  *fileSystem;
 
 #ifdef FILESYS
 SynchDisk   *synchDisk;
+NameCache   *nameCache;
+Journal     *journal;
 #endif
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
@@ -66,18 +68,6 @@ TimerInterruptHandler(int dummy)
 	    interrupt->YieldOnReturn();
 }
 
-#define TIME_SLICE 150
-
-static void
-RRTimerInterruptHandler(int dummy)
-{
-    if (interrupt->getStatus() != IdleMode)
-    {
-        if(stats->totalTicks > currentThread->getStartTime() + TIME_SLICE)
-            interrupt->YieldOnReturn();
-    }
-}
-
 
 //----------------------------------------------------------------------
 // Initialize
@@ -95,6 +85,7 @@ Initialize(int argc, char **argv)
     int argCount;
     char* debugArgs = "";
     bool randomYield = FALSE;
+    SchedPolicy schedPolicy = SchedPriority;	// CPU scheduling policy
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
@@ -102,6 +93,10 @@ Initialize(int argc, char **argv)
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
 #endif
+#ifdef FILESYS
+    DiskPolicy diskPolicy = DiskCLOOK;	// disk scheduling policy
+    bool mapDisk = FALSE;		// map the disk file into memory
+#endif
 #ifdef NETWORK
     double rely = 1;		// network reliability
     int netname = 0;		// UNIX socket name
@@ -122,6 +117,17 @@ Initialize(int argc, char **argv)
 						// number generator
 	    randomYield = TRUE;
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-sched")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "priority"))
+		schedPolicy = SchedPriority;
+	    else if (!strcmp(*(argv + 1), "mlfq"))
+		schedPolicy = SchedMLFQ;
+	    else if (!strcmp(*(argv + 1), "fair"))
+		schedPolicy = SchedFair;
+	    else
+		fprintf(stderr, "Unknown scheduling policy %s\n", *(argv + 1));
+	    argCount = 2;
 	}
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
@@ -131,6 +137,23 @@ Initialize(int argc, char **argv)
 	if (!strcmp(*argv, "-f"))
 	    format = TRUE;
 #endif
+#ifdef FILESYS
+	if (!strcmp(*argv, "-ds")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "fcfs"))
+		diskPolicy = DiskFCFS;
+	    else if (!strcmp(*(argv + 1), "sstf"))
+		diskPolicy = DiskSSTF;
+	    else if (!strcmp(*(argv + 1), "scan"))
+		diskPolicy = DiskSCAN;
+	    else if (!strcmp(*(argv + 1), "clook"))
+		diskPolicy = DiskCLOOK;
+	    else
+		fprintf(stderr, "Unknown disk policy %s\n", *(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-dm"))
+	    mapDisk = TRUE;
+#endif
 #ifdef NETWORK
 	if (!strcmp(*argv, "-l")) {
 	    ASSERT(argc > 1);
@@ -147,13 +170,11 @@ Initialize(int argc, char **argv)
     DebugInit(debugArgs);			// initialize DEBUG messages
     stats = new Statistics();			// collect statistics
     interrupt = new Interrupt;			// start up interrupt handling
-    scheduler = new Scheduler();		// initialize the ready queue
+    scheduler = new Scheduler(schedPolicy);	// initialize the ready queue
+    alarmClock = new Alarm;			// nobody is asleep yet
     if (randomYield)				// start the timer (if needed)
 	    timer = new Timer(TimerInterruptHandler, 0, randomYield);
-    threadList = new List;    // initialize the list of threads
-
-    // initialize a timer for RR
-    RRTimer = new Timer(RRTimerInterruptHandler, 0, false, RR_TIMER);
+    threadTable = new ThreadTable;		// no threads yet
 
     threadToBeDestroyed = NULL;
 
@@ -162,6 +183,8 @@ Initialize(int argc, char **argv)
     // object to save its state. 
     currentThread = new Thread("main");		
     currentThread->setStatus(RUNNING);
+    currentThread->firstRunTime = currentThread->createTime;
+						// it is running already
 
     interrupt->Enable();
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
@@ -171,7 +194,9 @@ Initialize(int argc, char **argv)
 #endif
 
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    synchDisk = new SynchDisk("DISK", diskPolicy, mapDisk);
+    nameCache = new NameCache(NameCacheSize);
+    journal = new Journal;		// the file system finds the log
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -183,9 +208,57 @@ Initialize(int argc, char **argv)
 #endif
 }
 
+//----------------------------------------------------------------------
+// SyncFileSystem
+// 	Nachos is about to halt.  Commit and empty the journal, and
+//	write the buffer cache back to disk.  Both wait for the disk, so
+//	this is called by a thread that can block, before Cleanup.
+//----------------------------------------------------------------------
+void
+SyncFileSystem()
+{
+#ifdef FILESYS
+    journal->Checkpoint();		// commit, and empty the journal
+    synchDisk->Flush();			// write back the cache
+#endif
+}
+
+//----------------------------------------------------------------------
+// ForkHalt
+// 	Called by Interrupt::Idle when nothing is left to run.  The thread
+//	that got there is asleep, or finished, so it cannot wait for the
+//	disk itself; start a thread that writes the file system back and
+//	then halts, and return TRUE.  Returns FALSE if there is nothing to
+//	write back, or if that thread has been started already.
+//----------------------------------------------------------------------
+
+static void
+HaltThread(int dummy)
+{
+    interrupt->Halt();			// which calls SyncFileSystem first
+}
+
+bool
+ForkHalt()
+{
+#ifdef FILESYS
+    static bool forked = FALSE;
+
+    if (!forked) {
+	forked = TRUE;
+	Thread *thread = new Thread("halt");
+	thread->Fork(HaltThread, 0);
+	return TRUE;
+    }
+#endif
+    return FALSE;
+}
+
 //----------------------------------------------------------------------
 // Cleanup
-// 	Nachos is halting.  De-allocate global data structures.
+// 	Nachos is halting.  De-allocate global data structures.  This
+//	must not wait for anything: it is also called from Interrupt::Idle,
+//	and on ctl-C.
 //----------------------------------------------------------------------
 void
 Cleanup()
@@ -204,10 +277,13 @@ Cleanup()
 #endif
 
 #ifdef FILESYS
+    delete journal;
     delete synchDisk;
+    delete nameCache;
 #endif
     
     delete timer;
+    delete alarmClock;
     delete scheduler;
     delete interrupt;
     
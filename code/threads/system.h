@@ -16,12 +16,19 @@
 #include "stats.h"
 #include "timer.h"
 #include "synch.h"
+#include "alarm.h"
+#include "threadtable.h"
 
 // Initialization and cleanup routines
 extern void Initialize(int argc, char **argv); 	// Initialization,
 						// called before anything else
 extern void Cleanup();				// Cleanup, called when
 						// Nachos is done.
+extern void SyncFileSystem();			// Write everything back to
+						// disk before halting; may
+						// wait for the disk
+extern bool ForkHalt();				// Halt from a new thread,
+						// which can wait for the disk
 
 extern Thread *currentThread;			// the thread holding the CPU
 extern Thread *threadToBeDestroyed;  		// the thread that just finished
@@ -29,8 +36,9 @@ extern Scheduler *scheduler;			// the ready list
 extern Interrupt *interrupt;			// interrupt status
 extern Statistics *stats;			// performance metrics
 extern Timer *timer;				// the hardware alarm clock
-extern Timer *RRTimer;     // timer for RR scheduling
-extern List *threadList;   // a list of threads
+extern Alarm *alarmClock;			// threads sleeping until a
+						// given time
+extern ThreadTable *threadTable;		// every thread, by tid
 
 #ifdef USER_PROGRAM
 #include "machine.h"
@@ -44,7 +52,11 @@ extern FileSystem  *fileSystem;
 
 #ifdef FILESYS
 #include "synchdisk.h"
+#include "namecache.h"
+#include "journal.h"
 extern SynchDisk   *synchDisk;
+extern NameCache   *nameCache;
+extern Journal     *journal;
 #endif
 
 #ifdef NETWORK
@@ -24,6 +24,11 @@
 					// execution stack, for detecting 
 					// stack overflows
 
+// Stacks of deleted threads, to be reused by new ones rather than
+// allocating (and fencing) a new one on the host each time
+static int *freeStacks[StackPoolSize];
+static int numFreeStacks = 0;
+
 //----------------------------------------------------------------------
 // Thread::Thread
 // 	Initialize a thread control block, so that we can then call
@@ -37,29 +42,32 @@ Thread::Thread(char* debugName, int priorityLevel = LowestPriority)
     name = debugName;
     uid = 0;
     tid = threadSeq++;
-    if(LowestPriority < 0)
+    if(priorityLevel < 0)
         priority = 0;
-    else if(LowestPriority > PriorityLevelSize)
+    else if(priorityLevel > LowestPriority)
         priority = LowestPriority;
     else
         priority = priorityLevel;
     stackTop = NULL;
     stack = NULL;
     status = JUST_CREATED;
-    threadList->Append((void *)this);
+    threadTable->Add(this);
     startTime = 0;
+    level = quantumUsed = 0;
+    createTime = readySince = stats->totalTicks;
+    firstRunTime = -1;
+    waitTicks = runTicks = 0;
+    weight = DefaultWeight;
+    vruntime = 0;
 #ifdef USER_PROGRAM
     space = NULL;
 #endif
     for(int i = 0; i < OpenFileTableSize; i++)
         openFileTable[i].valid = false;
-    for(int i = 0; i < ChildThreadSize; i++)
-        child[i] = NULL;
+    parent = firstChild = NULL;
+    joinTid = -1;
     if(currentThread != NULL)
-    {
-        parent = currentThread;
         currentThread->AddChild(this);
-    }
 }
 
 //----------------------------------------------------------------------
@@ -80,14 +88,66 @@ Thread::~Thread()
 
     ASSERT(this != currentThread);
 
-    threadList->Remove((void *)this);
+    threadTable->Remove(this);
 
     if(parent != NULL)
+    {
+        if(parent->joinTid == tid)	// waiting for us in WaitTid
+        {
+            IntStatus oldLevel = interrupt->SetLevel(IntOff);
+            parent->joinTid = -1;
+            scheduler->ReadyToRun(parent);
+            (void) interrupt->SetLevel(oldLevel);
+        }
         parent->RemoveChild(this);
+    }
+    for(Thread* c = firstChild; c != NULL; c = c->nextSibling)
+        c->parent = NULL;		// orphans now
+
+    if (stack != NULL) {
+	if (numFreeStacks < StackPoolSize)
+	    freeStacks[numFreeStacks++] = stack;	// keep it for later
+	else
+	    DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+    }
+}
 
-    if (stack != NULL)
-	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+//----------------------------------------------------------------------
+// Thread::operator new
+// Thread::operator delete
+// 	Allocate the memory for a Thread, reusing that of a deleted one
+//	if there is one; keep the memory of a deleted Thread for reuse,
+//	unless ThreadPoolSize are kept already.
+//----------------------------------------------------------------------
 
+void *Thread::freeThreads = NULL;
+int Thread::numFreeThreads = 0;
+
+void *
+Thread::operator new(size_t size)
+{
+    ASSERT(size == sizeof(Thread));
+    if (freeThreads == NULL)
+	return ::operator new(size);
+
+    void *p = freeThreads;
+    freeThreads = *(void **)p;
+    numFreeThreads--;
+    return p;
+}
+
+void
+Thread::operator delete(void *p)
+{
+    if (p == NULL)
+	return;
+    if (numFreeThreads == ThreadPoolSize) {
+	::operator delete(p);
+	return;
+    }
+    *(void **)p = freeThreads;
+    freeThreads = p;
+    numFreeThreads++;
 }
 
 
@@ -180,6 +240,13 @@ Thread::Finish ()
     ASSERT(this == currentThread);
     
     DEBUG('t', "Finishing thread \"%s\"\n", getName());
+    DEBUG('t', "Thread \"%s\": response %d, wait %d, run %d ticks\n",
+          getName(), firstRunTime - createTime, waitTicks,
+          runTicks + stats->totalTicks - startTime);
+
+    stats->numThreadsFinished++;
+    stats->threadResponseTicks += firstRunTime - createTime;
+    stats->threadWaitTicks += waitTicks;
     
     threadToBeDestroyed = currentThread;
     Sleep();					// invokes SWITCH
@@ -275,7 +342,8 @@ void ThreadPrint(int arg){ Thread *t = (Thread *)arg; t->Print(); }
 void ThreadStatePrint(int arg){ Thread *t = (Thread *)arg; t->StatePrint(); }
 //----------------------------------------------------------------------
 // Thread::StackAllocate
-//	Allocate and initialize an execution stack.  The stack is
+//	Allocate and initialize an execution stack, or reuse one left
+//	by a deleted thread.  The stack is
 //	initialized with an initial stack frame for ThreadRoot, which:
 //		enables interrupts
 //		calls (*func)(arg)
@@ -288,7 +356,10 @@ void ThreadStatePrint(int arg){ Thread *t = (Thread *)arg; t->StatePrint(); }
 void
 Thread::StackAllocate (VoidFunctionPtr func, void *arg)
 {
-    stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
+    if (numFreeStacks > 0)
+	stack = freeStacks[--numFreeStacks];
+    else
+	stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
 
 #ifdef HOST_SNAKE
     // HP stack works from low addresses to high addresses
@@ -324,18 +395,12 @@ int Thread::threadSeq = 0;
 
 //----------------------------------------------------------------------
 // createThread
-// wrapper function for Thread::Thread, control the number of threads
-// if number of threads existing in less than maximun, return a pointer
-// to a new Thread, else return NULL, the caller should use this function
-// instead of Thread::Thread and should check the return value
+// wrapper function for Thread::Thread; the number of threads used to
+// be limited, and callers still check for a NULL return, but now there
+// is no limit other than memory
 //----------------------------------------------------------------------
 Thread* createThread(char* threadName, int priorityLevel = LowestPriority)
 {
-    if(threadList->NumInList() == ThreadListSize)
-    {   
-        DEBUG('t', "thread count exceeds\n");
-        return NULL;
-    }
     return new Thread(threadName, priorityLevel);
 }
 
@@ -347,17 +412,18 @@ Thread* createThread(char* threadName, int priorityLevel = LowestPriority)
 void TS()
 {
     printf("%-6s%-6s%-20s\n", "tid", "uid", "name");
-    threadList->Mapcar((VoidFunctionPtr) ThreadStatePrint);
+    threadTable->Mapcar((VoidFunctionPtr) ThreadStatePrint);
 }
 
 int
-Thread::OpenFileTableAdd(void* _openFile)
+Thread::OpenFileTableAdd(void* _openFile, OpenFileType _type)
 {
     for(int i = 2; i < OpenFileTableSize; i++)
     {
         if(openFileTable[i].valid == false)
         {
             openFileTable[i].valid = true;
+            openFileTable[i].type = _type;
             openFileTable[i].openFile = _openFile;
             return i;
         }
@@ -365,15 +431,36 @@ Thread::OpenFileTableAdd(void* _openFile)
     return -1;
 }
 
+// set up a given id, such as ConsoleInput/ConsoleOutput to redirect
+// them; an entry there is used instead of the console
+void
+Thread::OpenFileTableSet(int _openFileId, void* _openFile, OpenFileType _type)
+{
+    ASSERT(_openFileId >= 0 && _openFileId < OpenFileTableSize);
+    ASSERT(!openFileTable[_openFileId].valid);
+    openFileTable[_openFileId].valid = true;
+    openFileTable[_openFileId].type = _type;
+    openFileTable[_openFileId].openFile = _openFile;
+}
+
 void*
 Thread::OpenFileTableFind(int _openFileId)
 {
+    if(_openFileId < 0 || _openFileId >= OpenFileTableSize)
+        return NULL;
     if(openFileTable[_openFileId].valid)
         return openFileTable[_openFileId].openFile;
     else
         return NULL;
 }
 
+OpenFileType
+Thread::OpenFileTableType(int _openFileId)
+{
+    ASSERT(openFileTable[_openFileId].valid);
+    return openFileTable[_openFileId].type;
+}
+
 bool
 Thread::OpenFileTableRemove(int _openFileId)
 {
@@ -385,53 +472,40 @@ Thread::OpenFileTableRemove(int _openFileId)
 void
 Thread::WaitTid(int childTid)
 {
-    int idx = -1;
-    for(int i = 0; i < ChildThreadSize; i++)
-    {
-        if(child[i] != NULL)
-            if(child[i]->tid == childTid)
-            {
-                idx = i;
-                break;
-            }
-    }
-    if(idx == -1)
-    {
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Thread* childThread = threadTable->Find(childTid);
+    if(childThread == NULL || childThread->parent != this)
         printf("Failed to find child thread #%d\n", childTid);
-        return;
+    else
+    {
+        joinTid = childTid;		// ~Thread wakes us up when the
+        Sleep();			// child is deleted
     }
-    while(child[idx] != NULL)
-        Yield();
+    (void) interrupt->SetLevel(oldLevel);
 }
 
 void
 Thread::AddChild(Thread* childThread)
 {
-    for(int i = 0; i < ChildThreadSize; i++)
-    {
-        if(child[i] == NULL)
-        {
-            child[i] = childThread;
-            return;
-        }
-    }
-    printf("Failed to add a child!\n");
-    ASSERT(false);
+    childThread->parent = this;
+    childThread->prevSibling = NULL;
+    childThread->nextSibling = firstChild;
+    if(firstChild != NULL)
+        firstChild->prevSibling = childThread;
+    firstChild = childThread;
 }
 
 void
 Thread::RemoveChild(Thread* childThread)
 {
-    for(int i = 0; i < ChildThreadSize; i++)
-    {
-        if(child[i] == childThread)
-        {
-            child[i] = NULL;
-            return;
-        }
-    }
-    printf("Failed to remove a child!\n");
-    ASSERT(false);
+    ASSERT(childThread->parent == this);
+    if(childThread->prevSibling == NULL)
+        firstChild = childThread->nextSibling;
+    else
+        childThread->prevSibling->nextSibling = childThread->nextSibling;
+    if(childThread->nextSibling != NULL)
+        childThread->nextSibling->prevSibling = childThread->prevSibling;
+    childThread->parent = NULL;
 }
 
 #ifdef USER_PROGRAM
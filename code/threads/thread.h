@@ -39,6 +39,7 @@
 
 #include "copyright.h"
 #include "utility.h"
+#include "dlist.h"
 
 #ifdef USER_PROGRAM
 #include "machine.h"
@@ -55,12 +56,18 @@
 // WATCH OUT IF THIS ISN'T BIG ENOUGH!!!!!
 #define StackSize	(4 * 1024)	// in words
 
-// max number of threads existing
-#define ThreadListSize 5
+// Stacks and Thread objects of finished threads are kept for the next
+// threads to be created, up to this many of each
+#define StackPoolSize 16
+#define ThreadPoolSize 16
 
 // priority level
 #define PriorityLevelSize 32
 #define LowestPriority PriorityLevelSize - 1
+
+// share of the CPU a thread gets under the fair scheduler, relative
+// to the other threads' weights
+#define DefaultWeight 1024
 // Thread state
 enum ThreadStatus { JUST_CREATED, RUNNING, READY, BLOCKED };
 
@@ -69,11 +76,14 @@ extern void ThreadPrint(int arg);
 extern void ThreadStatePrint(int arg);
 
 #define OpenFileTableSize 32
-#define ChildThreadSize 10
+
+// What an open file id refers to
+enum OpenFileType { OPEN_FILE, PIPE_READ_END, PIPE_WRITE_END };
 
 typedef struct{
   bool valid;
-  void* openFile;
+  OpenFileType type;
+  void* openFile;	// an OpenFile, or a PipeBuffer for either end
 } OpenFileTableEntry;
 
 // The following class defines a "thread control block" -- which
@@ -101,6 +111,13 @@ class Thread {
 					// must not be running when delete 
 					// is called
 
+    static void *operator new(size_t size);
+					// Reuse the memory of a deleted
+    static void operator delete(void *p);
+					// Thread if there is one, and keep
+					// it when deleting, up to
+					// ThreadPoolSize
+
     // basic thread operations
 
     void Fork(VoidFunctionPtr func, void *arg); 	// Make thread run (*func)(arg)
@@ -113,6 +130,7 @@ class Thread {
     void CheckOverflow();   			// Check if thread has 
 						// overflowed its stack
     void setStatus(ThreadStatus st) { status = st; }
+    ThreadStatus getStatus() { return status; }
     char* getName() { return (name); }
     int getUid() { return uid; }
     int getTid() { return tid; }
@@ -125,9 +143,26 @@ class Thread {
 
     void setStartTime(int time){ startTime = time; }
     int getStartTime(){ return startTime; }
+
+    // kept up to date by the scheduler
+    int level;			// MLFQ level, 0 is the highest
+    int quantumUsed;		// ticks run at this level so far
+    int createTime;		// when the thread was created
+    int firstRunTime;		// when it first ran, -1 if it has not
+    int readySince;		// when it was last made ready
+    int waitTicks;		// ticks spent ready, but not running
+    int runTicks;		// ticks spent running
+    int weight;			// share of the CPU under SchedFair
+    int vruntime;		// ticks run, times DefaultWeight / weight
+    DLink<Thread> queueLink;	// links us into the ready queue, or the
+				// queue of a synchronization primitive
+				// we are waiting on; never both at once
     
-    int OpenFileTableAdd(void* _openFile);
+    int OpenFileTableAdd(void* _openFile, OpenFileType _type = OPEN_FILE);
+    void OpenFileTableSet(int _openFileId, void* _openFile,
+                          OpenFileType _type);
     void* OpenFileTableFind(int _openFileId);
+    OpenFileType OpenFileTableType(int _openFileId);
     bool OpenFileTableRemove(int _openFileId);
 
     void AddChild(Thread* childThread);
@@ -145,13 +180,26 @@ class Thread {
     int tid;  // thread id
     int priority; // thread priority
     static int threadSeq; // tid for next thread
+    static void *freeThreads;		// deleted Threads, to be reused;
+					// each points to the next
+    static int numFreeThreads;
 
     int startTime;  // time of being scheduled
 
     OpenFileTableEntry openFileTable[OpenFileTableSize];
 
-    Thread* child[ChildThreadSize];
-    Thread* parent;
+    Thread* parent;			// thread that created us, NULL if
+					// none, or if it has gone away
+    Thread* firstChild;			// threads we created, linked
+    Thread* prevSibling;		// through their sibling pointers
+    Thread* nextSibling;
+    int joinTid;			// child we are asleep waiting for,
+					// -1 if none
+
+    friend class ThreadTable;		// links threads through these:
+    Thread* hashNext;			// next thread in the same bucket
+    Thread* tablePrev;			// threads created just before and
+    Thread* tableNext;			// after us
 
     void StackAllocate(VoidFunctionPtr func, void *arg);
     					// Allocate a stack for thread.
@@ -172,6 +220,10 @@ class Thread {
 #endif
 };
 
+// A queue of threads, linked through their queueLink; putting a
+// thread on it, or taking one off, allocates nothing
+typedef DList<Thread, &Thread::queueLink> ThreadQueue;
+
 // Magical machine-dependent routines, defined in switch.s
 
 extern "C" {
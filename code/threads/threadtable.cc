@@ -0,0 +1,148 @@
+// threadtable.cc
+//	Routines to keep track of all existing threads (cf. threadtable.h).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "threadtable.h"
+
+//----------------------------------------------------------------------
+// ThreadTable::ThreadTable
+// 	Initialize an empty thread table.
+//----------------------------------------------------------------------
+
+ThreadTable::ThreadTable()
+{
+    numBuckets = 16;
+    buckets = new Thread *[numBuckets];
+    for (int i = 0; i < numBuckets; i++)
+	buckets[i] = NULL;
+    count = 0;
+    first = last = NULL;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::~ThreadTable
+// 	De-allocate the thread table.
+//----------------------------------------------------------------------
+
+ThreadTable::~ThreadTable()
+{
+    delete [] buckets;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Add
+// 	Enter a newly created thread in the table, after all the others.
+//
+//	"thread" is the new thread; no other thread has its tid
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Add(Thread *thread)
+{
+    if (count >= 2 * numBuckets)
+	Grow();
+
+    int bucket = thread->getTid() & (numBuckets - 1);
+    thread->hashNext = buckets[bucket];
+    buckets[bucket] = thread;
+
+    thread->tablePrev = last;
+    thread->tableNext = NULL;
+    if (last == NULL)
+	first = thread;
+    else
+	last->tableNext = thread;
+    last = thread;
+    count++;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Remove
+// 	Take a thread that is being deleted out of the table.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Remove(Thread *thread)
+{
+    Thread **link = &buckets[thread->getTid() & (numBuckets - 1)];
+
+    while (*link != thread) {
+	ASSERT(*link != NULL);		// should always find the thread
+	link = &(*link)->hashNext;
+    }
+    *link = thread->hashNext;
+
+    if (thread->tablePrev == NULL)
+	first = thread->tableNext;
+    else
+	thread->tablePrev->tableNext = thread->tableNext;
+    if (thread->tableNext == NULL)
+	last = thread->tablePrev;
+    else
+	thread->tableNext->tablePrev = thread->tablePrev;
+    count--;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Find
+// 	Return the thread whose id is "tid", or NULL if there is none
+//	(any more).
+//----------------------------------------------------------------------
+
+Thread *
+ThreadTable::Find(int tid)
+{
+    Thread *thread;
+
+    for (thread = buckets[tid & (numBuckets - 1)]; thread != NULL;
+						thread = thread->hashNext)
+	if (thread->getTid() == tid)
+	    return thread;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Mapcar
+// 	Apply a function to each thread, oldest first.  The function
+//	must not delete the thread it is given.
+//
+//	"func" is the procedure to apply; it is passed the Thread
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Mapcar(VoidFunctionPtr func)
+{
+    for (Thread *thread = first; thread != NULL; thread = thread->tableNext)
+	(*func)((int)thread);
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Grow
+// 	Double the number of hash buckets, so the chains stay short.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Grow()
+{
+    int oldNumBuckets = numBuckets;
+    Thread **oldBuckets = buckets;
+
+    numBuckets *= 2;
+    buckets = new Thread *[numBuckets];
+    for (int i = 0; i < numBuckets; i++)
+	buckets[i] = NULL;
+    for (int i = 0; i < oldNumBuckets; i++) {
+	Thread *thread, *next;
+	for (thread = oldBuckets[i]; thread != NULL; thread = next) {
+	    next = thread->hashNext;
+	    int bucket = thread->getTid() & (numBuckets - 1);
+	    thread->hashNext = buckets[bucket];
+	    buckets[bucket] = thread;
+	}
+    }
+    delete [] oldBuckets;
+}
@@ -0,0 +1,50 @@
+// threadtable.h
+//	Data structures to find every existing thread, and any thread
+//	by its thread id.
+//
+//	Threads are kept in a hash table on their tid, which grows with
+//	the number of threads, so finding one takes constant time however
+//	many there are; and on a list in the order they were created, for
+//	walking through all of them.  Both are linked through the Thread
+//	objects themselves, so adding and removing a thread allocates
+//	nothing (except when the hash table grows).
+//
+//	We assume mutual exclusion is provided by the caller.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef THREADTABLE_H
+#define THREADTABLE_H
+
+#include "copyright.h"
+#include "thread.h"
+
+// The following class defines the table of all threads.
+
+class ThreadTable {
+  public:
+    ThreadTable();			// Initialize an empty table
+    ~ThreadTable();			// De-allocate the table; the threads
+					// in it are not deleted
+
+    void Add(Thread *thread);		// Enter a new thread
+    void Remove(Thread *thread);	// Forget a thread that is going away
+    Thread *Find(int tid);		// The thread with id "tid", or NULL
+
+    int NumThreads() { return count; }
+    void Mapcar(VoidFunctionPtr func);	// Apply "func" to every thread, in
+					// the order they were created
+
+  private:
+    Thread **buckets;			// Hash chains, linked by hashNext
+    int numBuckets;			// Always a power of two
+    int count;				// Number of threads in the table
+    Thread *first;			// Oldest thread, NULL if none
+    Thread *last;			// Newest thread
+
+    void Grow();			// Double the number of buckets
+};
+
+#endif // THREADTABLE_H
@@ -65,7 +65,7 @@ ThreadTest2()
 
     
 
-    for(int i = 1; i <= ThreadListSize; ++i)
+    for(int i = 1; i <= 5; ++i)
     {
         Thread *t = createThread("forked thread");
         if(t)
@@ -291,6 +291,90 @@ ThreadTest7()
     Writer(0);
 }
 
+//----------------------------------------------------------------------
+// ThreadTest8: CPU shares
+// 	Run a few CPU-bound threads with different weights for a while,
+//	and compare the CPU each one got with its weight.  Run with
+//	"-sched fair" to see the shares follow the weights, and with the
+//	other policies to see them come out even.
+//----------------------------------------------------------------------
+#define ShareThreads	3
+#define ShareTicks	60000
+
+static int shareRun[ShareThreads];	// ticks each thread ran
+static Semaphore *shareDone;
+static int shareEnd;
+
+void
+ShareThread(int which)
+{
+    while (stats->totalTicks < shareEnd)
+        interrupt->OneTick();
+    shareRun[which] = currentThread->runTicks
+                        + stats->totalTicks - currentThread->getStartTime();
+    shareDone->V();
+}
+
+void
+ThreadTest8()
+{
+    DEBUG('t', "Entering ThreadTest8");
+
+    int totalWeight = 0, totalRun = 0;
+
+    shareDone = new Semaphore("shareDone", 0);
+    shareEnd = stats->totalTicks + ShareTicks;
+    for(int i = 0; i < ShareThreads; i++)
+    {
+        Thread *t = new Thread("share thread");
+        t->weight = DefaultWeight << i;
+        totalWeight += t->weight;
+        t->Fork(ShareThread, (void*)i);
+    }
+    for(int i = 0; i < ShareThreads; i++)
+        shareDone->P();
+    for(int i = 0; i < ShareThreads; i++)
+        totalRun += shareRun[i];
+
+    for(int i = 0; i < ShareThreads; i++)
+        printf("thread %d: weight %d, wanted %d%%, got %d%%\n", i,
+               DefaultWeight << i, 100 * (DefaultWeight << i) / totalWeight,
+               totalRun == 0 ? 0 : 100 * shareRun[i] / totalRun);
+}
+
+//----------------------------------------------------------------------
+// ThreadTest9: alarm clock
+// 	Put threads to sleep for different times, some of them long
+//	enough to start in the upper levels of the alarm's wheel, and
+//	check that each wakes up in time, and not before.
+//----------------------------------------------------------------------
+#define SleepThreads	6
+
+static int sleepTicks[SleepThreads] = { 50, 7000, 300, 500000, 4100, 100 };
+
+void
+SleepingThread(int which)
+{
+    int start = stats->totalTicks;
+
+    alarmClock->WaitUntil(start + sleepTicks[which]);
+    printf("thread %d: asked for %d ticks, slept %d\n", which,
+           sleepTicks[which], stats->totalTicks - start);
+    ASSERT(stats->totalTicks - start >= sleepTicks[which]);
+}
+
+void
+ThreadTest9()
+{
+    DEBUG('t', "Entering ThreadTest9");
+
+    for(int i = 0; i < SleepThreads; i++)
+    {
+        Thread *t = new Thread("sleeping thread");
+        t->Fork(SleepingThread, (void*)i);
+    }
+}
+
 //----------------------------------------------------------------------
 // ThreadTest
 // 	Invoke a test routine.
@@ -321,6 +405,12 @@ ThreadTest()
     case 7:
 	    ThreadTest7();
 	    break;
+    case 8:
+	    ThreadTest8();
+	    break;
+    case 9:
+	    ThreadTest9();
+	    break;
     default:
 	    printf("No test specified.\n");
 	    break;
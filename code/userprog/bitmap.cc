@@ -102,6 +102,52 @@ BitMap::Find()
     return -1;
 }
 
+//----------------------------------------------------------------------
+// BitMap::FindRun
+// 	Find a run of consecutive clear bits, and as a side effect set
+//	them all.  The first run of "wanted" bits found scanning forward
+//	from "hint" (wrapping around at the end) is taken; if there is
+//	no run that long, the longest run available is taken instead.
+//	Runs never wrap around the end of the bitmap.
+//
+//	Return the number of the first bit of the run, and its length
+//	in "*length".  If no bits are clear, return -1.
+//
+//	"hint" is where to start looking, usually just past the previous
+//		run allocated to the same owner
+//	"wanted" is the maximum number of bits to allocate
+//----------------------------------------------------------------------
+
+int
+BitMap::FindRun(int hint, int wanted, int *length)
+{
+    int best = -1, bestLen = 0;
+
+    if (hint < 0 || hint >= numBits)
+	hint = 0;
+    for (int k = 0; k < numBits; k++) {
+	int i = (hint + k) % numBits;
+	if (Test(i))
+	    continue;
+	int len = 0;
+	while (i + len < numBits && len < wanted && !Test(i + len))
+	    len++;
+	if (len > bestLen) {
+	    best = i;
+	    bestLen = len;
+	    if (len == wanted)
+		break;
+	}
+	k += len - 1;		// skip over the rest of this run
+    }
+    if (best == -1)
+	return -1;
+    for (int i = best; i < best + bestLen; i++)
+	Mark(i);
+    *length = bestLen;
+    return best;
+}
+
 //----------------------------------------------------------------------
 // BitMap::NumClear
 // 	Return the number of clear bits in the bitmap.
@@ -43,6 +43,11 @@ class BitMap {
     int Find();            	// Return the # of a clear bit, and as a side
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
+    int FindRun(int hint, int wanted, int *length);
+				// Find and set a run of up to "wanted"
+				// consecutive clear bits, preferring one
+				// at or after "hint".  Return its first
+				// bit and its length in *length, or -1.
     int NumClear();		// Return the number of clear bits
 
     void Print();		// Print contents of bitmap
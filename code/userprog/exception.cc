@@ -25,6 +25,7 @@
 #include "system.h"
 #include "syscall.h"
 #include "addrspace.h"
+#include "pipe.h"
 
 static void ReadBuffer(int virtualAddr, char* buffer)
 {
@@ -44,7 +45,14 @@ void JoinHandler();
 void ExecHandler();
 void ForkHandler();
 void YieldHandler();
+void SleepHandler();
 void ExitHandler();
+void PipeHandler();
+void ExecIOHandler();
+void PreadHandler();
+void PwriteHandler();
+void ReadvHandler();
+void WritevHandler();
 #ifdef FILESYS
 void LsHandler();
 void MvHandler();
@@ -113,6 +121,13 @@ ExceptionHandler(ExceptionType which)
                 case SC_Close:CloseHandler();break;
                 case SC_Fork:ForkHandler();break;
                 case SC_Yield:YieldHandler();break;
+                case SC_Sleep:SleepHandler();break;
+                case SC_Pipe:PipeHandler();break;
+                case SC_ExecIO:ExecIOHandler();break;
+                case SC_Pread:PreadHandler();break;
+                case SC_Pwrite:PwriteHandler();break;
+                case SC_Readv:ReadvHandler();break;
+                case SC_Writev:WritevHandler();break;
 #ifdef FILESYS
                 case SC_LS:LsHandler();break;
                 case SC_MV:MvHandler();break;
@@ -186,35 +201,111 @@ void OpenHandler()
     machine->PcPlus4();
 }
 
+// close an open file id of the current thread; a pipe is deleted
+// once both of its ends are closed everywhere
+static bool CloseOpenFileId(int openFileId)
+{
+    void* openFile = currentThread->OpenFileTableFind(openFileId);
+    if(openFile == NULL)
+        return false;
+    OpenFileType type = currentThread->OpenFileTableType(openFileId);
+    currentThread->OpenFileTableRemove(openFileId);
+    if(type == OPEN_FILE)
+        delete (OpenFile*)openFile;
+    else if(((PipeBuffer*)openFile)->CloseEnd(type == PIPE_WRITE_END))
+        delete (PipeBuffer*)openFile;
+    return true;
+}
+
 void CloseHandler()
 {
     int openFileId = machine->ReadRegister(4);
 
-    OpenFile* openFile = currentThread->OpenFileTableFind(openFileId);
-    currentThread->OpenFileTableRemove(openFileId);
-    if(openFile != NULL)
+    if(CloseOpenFileId(openFileId))
     {
 #ifdef SHOWTRACE
         printf("Close file with id %d succeed!\n", openFileId);
 #endif
-        delete openFile;
     }
     else
         printf("Close file with id %d fail!\n", openFileId);
     machine->PcPlus4();
 }
 
+// the address in main memory of user address "virtualAddr", bringing
+// its page in first if need be; NULL if the address is not valid.
+// The page may be swapped out again by the next thread to run, so the
+// address is only good until this thread blocks
+static char* UserAddress(int virtualAddr, bool writing)
+{
+    int physicalAddr;
+    ExceptionType exception =
+        machine->Translate(virtualAddr, &physicalAddr, 1, writing);
+    while(exception == PageFaultException)
+    {
+        machine->WriteRegister(BadVAddrReg, virtualAddr);
+        PageFaultExceptionHandler();
+        exception = machine->Translate(virtualAddr, &physicalAddr, 1, writing);
+    }
+    if(exception != NoException)
+        return NULL;
+    return machine->mainMemory + physicalAddr;
+}
+
+// copy "size" bytes from "from" in the kernel to the user buffer at
+// "virtualAddr", a page at a time, bringing the pages in as need be;
+// FALSE if part of the buffer is not valid
+static bool CopyOut(int virtualAddr, char* from, int size)
+{
+    int done = 0;
+    while(done < size)
+    {
+        int chunk = PageSize - (virtualAddr + done) % PageSize;
+        if(chunk > size - done)
+            chunk = size - done;
+        char* to = UserAddress(virtualAddr + done, true);
+        if(to == NULL)
+            return false;
+        bcopy(from + done, to, chunk);
+        done += chunk;
+    }
+    return true;
+}
+
 void ReadHandler()
 {
     int virtualAddr = machine->ReadRegister(4);
     int size = machine->ReadRegister(5);
     OpenFileId openFileId =  machine->ReadRegister(6);
 
+    // a pipe may make us wait, so read into the kernel first, and copy
+    // out through the page table afterwards
+    void* openEntry = currentThread->OpenFileTableFind(openFileId);
+    if(openEntry != NULL
+        && currentThread->OpenFileTableType(openFileId) != OPEN_FILE)
+    {
+        int readSize = -1;
+        if(currentThread->OpenFileTableType(openFileId) == PIPE_READ_END)
+        {
+            char* pipeBuffer = new char[size];
+            readSize = ((PipeBuffer*)openEntry)->Read(pipeBuffer, size);
+            // the buffer may have been paged out while we waited
+            if(readSize > 0 && !CopyOut(virtualAddr, pipeBuffer, readSize))
+                readSize = -1;
+            delete [] pipeBuffer;
+        }
+        else
+            printf("Read fail!\n");
+        machine->WriteRegister(2,readSize);
+        machine->PcPlus4();
+        return;
+    }
+
     int physicalAddr;
     machine->Translate(virtualAddr, &physicalAddr, 1, false);
     char* buffer = machine->mainMemory + physicalAddr;
 
-    if(openFileId == ConsoleInput)
+    if(openFileId == ConsoleInput && openEntry == NULL)
     {
         for(int i = 0; i < size; i++)
             scanf("%c",buffer + i);
@@ -250,16 +341,25 @@ void WriteHandler()
     for(int i = 0; i < size; i++)
         machine->ReadMem(bufferIdx + i, 1, (int*)&buffer[i]);
         
-    if(openFileId == ConsoleOutput)
+    void* openEntry = currentThread->OpenFileTableFind(openFileId);
+    if(openFileId == ConsoleOutput && openEntry == NULL)
     {
         for(int i = 0; i < size; i++)
             printf("%c", buffer[i]);
         machine->PcPlus4();
+        delete [] buffer;
         return;
     }    
 
-    OpenFile* openFile = currentThread->OpenFileTableFind(openFileId);
-    if(openFile != NULL)
+    OpenFile* openFile = (OpenFile*)openEntry;
+    if(openEntry != NULL
+        && currentThread->OpenFileTableType(openFileId) != OPEN_FILE)
+    {
+        if(currentThread->OpenFileTableType(openFileId) != PIPE_WRITE_END
+            || ((PipeBuffer*)openEntry)->Write(buffer, size) < 0)
+            printf("Write fail!\n");
+    }
+    else if(openFile != NULL)
     {
         openFile->Write(buffer,size);
 #ifdef SHOWTRACE 
@@ -271,7 +371,173 @@ void WriteHandler()
         printf("Write fail!\n");
     machine->PcPlus4();
 
-    delete buffer;
+    delete [] buffer;
+}
+
+// move "size" bytes between the user buffer at "virtualAddr" and
+// "openFile" at "position", a page at a time; return the number of
+// bytes moved.  The file system may block on the disk, and meanwhile
+// the user page may be given to another process, so each page goes
+// through a buffer on our stack, and is translated again right before
+// it is copied to or from main memory
+static int UserFileIO(OpenFile* openFile, int virtualAddr, int size,
+                      int position, bool writing)
+{
+    char page[PageSize];
+    int done = 0;
+    while(done < size)
+    {
+        int chunk = PageSize - (virtualAddr + done) % PageSize;
+        if(chunk > size - done)
+            chunk = size - done;
+        char* buffer;
+        int moved;
+        if(writing)
+        {
+            buffer = UserAddress(virtualAddr + done, false);
+            if(buffer == NULL)
+                break;
+            bcopy(buffer, page, chunk);
+            moved = openFile->WriteAt(page, chunk, position);
+        }
+        else
+        {
+            moved = openFile->ReadAt(page, chunk, position);
+            // reading from the file writes user memory
+            buffer = UserAddress(virtualAddr + done, true);
+            if(buffer == NULL)
+                break;
+            bcopy(page, buffer, moved);
+        }
+        done += moved;
+        position += moved;
+        if(moved < chunk)
+            break;                      // end of file
+    }
+    return done;
+}
+
+// the file "openFileId" of the current thread, for I/O at a position,
+// or NULL if it is not a file; while it is used, others may not write
+// it (or, if "writing", use it at all)
+static OpenFile* StartFileIO(OpenFileId openFileId, bool writing)
+{
+    OpenFile* openFile = (OpenFile*)currentThread->OpenFileTableFind(openFileId);
+    if(openFile == NULL
+        || currentThread->OpenFileTableType(openFileId) != OPEN_FILE)
+        return NULL;
+#ifdef FILESYS
+    if(writing)
+        synchDisk->StartWrite(openFile->GetHdrSector());
+    else
+        synchDisk->StartRead(openFile->GetHdrSector());
+    openFile->Update();
+#endif
+    return openFile;
+}
+
+static void FinishFileIO(OpenFile* openFile, bool writing)
+{
+#ifdef FILESYS
+    if(writing)
+        synchDisk->FinishWrite(openFile->GetHdrSector());
+    else
+        synchDisk->FinishRead(openFile->GetHdrSector());
+#endif
+}
+
+// Pread and Pwrite
+static void PositionalIO(bool writing)
+{
+    int virtualAddr = machine->ReadRegister(4);
+    int size = machine->ReadRegister(5);
+    OpenFileId openFileId = machine->ReadRegister(6);
+    int position = machine->ReadRegister(7);
+
+    int result = -1;
+    OpenFile* openFile = StartFileIO(openFileId, writing);
+    if(openFile != NULL)
+    {
+        if(size >= 0 && position >= 0)
+            result = UserFileIO(openFile, virtualAddr, size, position, writing);
+        FinishFileIO(openFile, writing);
+    }
+    machine->WriteRegister(2, result);
+    machine->PcPlus4();
+}
+
+void PreadHandler()
+{
+    PositionalIO(false);
+}
+
+void PwriteHandler()
+{
+    PositionalIO(true);
+}
+
+// Readv and Writev
+static void VectorIO(bool writing)
+{
+    int iovAddr = machine->ReadRegister(4);
+    int count = machine->ReadRegister(5);
+    OpenFileId openFileId = machine->ReadRegister(6);
+
+    int result = -1;
+    int iovBuffer[MaxIoVecs], iovSize[MaxIoVecs];    // an IoVec each
+    if(count < 0 || count > MaxIoVecs)
+    {
+        machine->WriteRegister(2, result);
+        machine->PcPlus4();
+        return;
+    }
+    // the vector itself is small; copy it in a word at a time
+    for(int i = 0; i < count * 2; i++)
+    {
+        int value;
+        if(!machine->ReadMem(iovAddr + 4 * i, 4, &value)
+            && !machine->ReadMem(iovAddr + 4 * i, 4, &value))
+        {
+            machine->WriteRegister(2, result);
+            machine->PcPlus4();
+            return;
+        }
+        if(i % 2 == 0)
+            iovBuffer[i / 2] = value;
+        else
+            iovSize[i / 2] = value;
+    }
+
+    OpenFile* openFile = StartFileIO(openFileId, writing);
+    if(openFile != NULL)
+    {
+        int position = openFile->GetSeekPosition();
+        result = 0;
+        for(int i = 0; i < count; i++)
+        {
+            if(iovSize[i] <= 0)
+                continue;
+            int moved = UserFileIO(openFile, iovBuffer[i], iovSize[i],
+                                   position + result, writing);
+            result += moved;
+            if(moved < iovSize[i])
+                break;
+        }
+        openFile->Seek(position + result);
+        FinishFileIO(openFile, writing);
+    }
+    machine->WriteRegister(2, result);
+    machine->PcPlus4();
+}
+
+void ReadvHandler()
+{
+    VectorIO(false);
+}
+
+void WritevHandler()
+{
+    VectorIO(true);
 }
 
 void JoinHandler()
@@ -281,10 +547,10 @@ void JoinHandler()
     machine->PcPlus4();
 }
 
-void ExecHandler()
+// load the program named at "virtualAddr" into a new thread, which is
+// not running yet; return NULL if there is no such program
+static Thread* LoadProgram(int virtualAddr)
 {
-    int virtualAddr = machine->ReadRegister(4);
-    
     char buffer[100];
     ReadBuffer(virtualAddr, buffer);
 
@@ -301,20 +567,93 @@ void ExecHandler()
 #endif
 
     OpenFile* executable = fileSystem->Open(execName);
-    if(executable != NULL)
+    if(executable == NULL)
+    {
+        printf("Can not find file %s\n",buffer);
+        return NULL;
+    }
+    Thread *thread = createThread("ExecThread");
+    AddrSpace *space = new AddrSpace(executable,execName);
+    thread->space = space;
+    delete executable;
+    return thread;
+}
+
+void ExecHandler()
+{
+    int virtualAddr = machine->ReadRegister(4);
+
+    Thread *thread = LoadProgram(virtualAddr);
+    if(thread != NULL)
     {
-        Thread *thread = createThread("ExecThread");
         machine->WriteRegister(2,thread->getTid());
-        AddrSpace *space = new AddrSpace(executable,execName);
-        thread->space = space;
         thread->Fork(ExecFunc,(void*)1);
-        delete executable;
     }
     else
+        machine->WriteRegister(2,-1);
+    machine->PcPlus4();
+}
+
+// give "thread" our open file id "openFileId" as its "stdId"
+// (ConsoleInput or ConsoleOutput); only pipe ends can be passed on
+static bool Redirect(Thread* thread, int stdId, OpenFileId openFileId)
+{
+    void* openEntry = currentThread->OpenFileTableFind(openFileId);
+    if(openEntry == NULL)
+        return openFileId == stdId;	// the console stays the console
+    OpenFileType type = currentThread->OpenFileTableType(openFileId);
+    if(type != (stdId == ConsoleInput ? PIPE_READ_END : PIPE_WRITE_END))
+        return false;
+    ((PipeBuffer*)openEntry)->OpenEnd(type == PIPE_WRITE_END);
+    thread->OpenFileTableSet(stdId, openEntry, type);
+    return true;
+}
+
+void ExecIOHandler()
+{
+    int virtualAddr = machine->ReadRegister(4);
+    OpenFileId input = machine->ReadRegister(5);
+    OpenFileId output = machine->ReadRegister(6);
+
+    Thread *thread = LoadProgram(virtualAddr);
+    if(thread != NULL)
     {
-        printf("Can not find file %s\n",buffer);
+        if(!Redirect(thread, ConsoleInput, input))
+            printf("ExecIO: can not read from file id %d\n", input);
+        if(!Redirect(thread, ConsoleOutput, output))
+            printf("ExecIO: can not write to file id %d\n", output);
+        machine->WriteRegister(2,thread->getTid());
+        thread->Fork(ExecFunc,(void*)1);
+    }
+    else
+        machine->WriteRegister(2,-1);
+    machine->PcPlus4();
+}
+
+void PipeHandler()
+{
+    int fdsAddr = machine->ReadRegister(4);
+
+    PipeBuffer* pipe = new PipeBuffer();
+    int readId = currentThread->OpenFileTableAdd((void*)pipe, PIPE_READ_END);
+    int writeId = -1;
+    if(readId != -1)
+        writeId = currentThread->OpenFileTableAdd((void*)pipe, PIPE_WRITE_END);
+    int fds[2];                         // as stored in user memory
+    fds[0] = WordToMachine(readId);
+    fds[1] = WordToMachine(writeId);
+    if(writeId == -1 || !CopyOut(fdsAddr, (char*)fds, sizeof(fds)))
+    {
+        printf("Pipe fail!\n");
+        if(readId != -1)
+            currentThread->OpenFileTableRemove(readId);
+        if(writeId != -1)
+            currentThread->OpenFileTableRemove(writeId);
+        delete pipe;
         machine->WriteRegister(2,-1);
     }
+    else
+        machine->WriteRegister(2,0);
     machine->PcPlus4();
 }
 
@@ -350,9 +689,19 @@ void YieldHandler()
     currentThread->Yield();
 }
 
+void SleepHandler()
+{
+    int ticks = machine->ReadRegister(4);
+    machine->PcPlus4();
+    alarmClock->WaitUntil(stats->totalTicks + ticks);
+}
+
 void ExitHandler()
 {
     // printf("Exit!\n");
+    // so that whoever reads our pipes sees end of file
+    for(int i = 0; i < OpenFileTableSize; i++)
+        CloseOpenFileId(i);
     machine->MemRecycle();
     currentThread->Finish();
 }
@@ -42,6 +42,15 @@
 #define SC_MSGSND   20
 #define SC_MSGRCV   21
 
+#define SC_Pipe     22
+#define SC_ExecIO   23
+
+#define SC_Pread    24
+#define SC_Pwrite   25
+#define SC_Readv    26
+#define SC_Writev   27
+#define SC_Sleep    28
+
 #ifndef IN_ASM
 
 /* The system call interface.  These are the operations the Nachos
@@ -120,6 +129,43 @@ int Read(char *buffer, int size, OpenFileId id);
 /* Close the file, we're done reading and writing to it. */
 void Close(OpenFileId id);
 
+/* Create a pipe: a buffer in memory, written at one end and read at the
+ * other.  Set fds[0] to the OpenFileId of the read end and fds[1] to
+ * that of the write end, and return 0; return -1 on failure.  Reading
+ * waits for data, and returns 0 once every write end is closed.
+ */
+int Pipe(OpenFileId fds[2]);
+
+/* Like Exec, but the new program uses "input" and "output" (each
+ * either a pipe end, or ConsoleInput/ConsoleOutput) as its
+ * ConsoleInput and ConsoleOutput.
+ */
+SpaceId ExecIO(char *name, OpenFileId input, OpenFileId output);
+
+/* Like Read and Write, but at byte "position" of the file, leaving its
+ * current position alone.  Return the number of bytes transferred, or
+ * -1 if "id" is not an open file (pipes and the console have no
+ * position).  Pwrite past the end of the file extends it.
+ */
+int Pread(char *buffer, int size, OpenFileId id, int position);
+int Pwrite(char *buffer, int size, OpenFileId id, int position);
+
+/* One of the buffers of Readv or Writev. */
+typedef struct {
+    char *buffer;
+    int size;
+} IoVec;
+
+#define MaxIoVecs	16	/* most buffers in one Readv or Writev */
+
+/* Read into, or write from, the "count" buffers described by "iov", in
+ * order, as if by one Read or Write at the current position of the
+ * file.  Return the number of bytes transferred, or -1 if "id" is not
+ * an open file or "count" is more than MaxIoVecs.
+ */
+int Readv(IoVec *iov, int count, OpenFileId id);
+int Writev(IoVec *iov, int count, OpenFileId id);
+
 
 
 /* User-level thread operations: Fork and Yield.  To allow multiple
@@ -131,6 +177,11 @@ void Close(OpenFileId id);
  */
 void Fork(void (*func)());
 
+/* Stop running for (at least) "ticks" units of simulated time, letting
+ * other threads have the CPU.
+ */
+void Sleep(int ticks);
+
 /* Yield the CPU to another runnable thread, whether in this address space 
  * or not. 
  */